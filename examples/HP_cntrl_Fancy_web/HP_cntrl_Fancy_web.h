@@ -1,349 +1,350 @@
-const char* html = R"====(<!DOCTYPE html>
-<html>
-<head>
-<meta name='viewport' content='width=device-width, initial-scale=1, user-scalable=yes'/>
-<meta http-equiv='refresh' content='_RATE_; url=/'/>
-<style>
-body {color:#DDD;font-size:40px;background:#333;}
-.button {
-    background-color: #4CAF50; /* Green */
-    border: none;
-    color: white;
-    padding: 5px;
-    text-align: center;
-    text-decoration: none;
-    display: inline-block;
-    font-size: 25px;
-}
-.switch {
-  position: relative;
-  display: inline-block;
-  height: 34px;
-}
-.sliderWidth{  width: 60px;}
-.switch input, .dropdown input {display:none;}
-.selected {
--webkit-filter: grayscale(100%);
-filter: grayscale(100%);
-text-align:center;}
-input:checked + .selected {
--webkit-filter: grayscale(0%);
-filter: grayscale(0%);}
-.fan, .auto{color:#0C0}
-.qspeed {width:20px;height:5px;}
-.speed{color:#c55;}
-.speedbar{width:20px; background:#c55; display:inline-block;}
-.speed1{height:05px;}
-.speed2{height:15px}
-.speed3{height:25px}
-.speed4{height:35px}
-.slider {
-  position: absolute;
-  cursor: pointer;
-  top: 0;
-  left: 0;
-  right: 0;
-  bottom: 0;
-  background-color: #ccc;
-  -webkit-transition: .4s;
-  transition: .4s;
-}
-.slider:before {
-  position: absolute;
-  content: "";
-  height: 26px;
-  width: 26px;
-  left: 4px;
-  bottom: 4px;
-  background-color: white;
-  -webkit-transition: .4s;
-  transition: .4s;
-}
-input:checked + .slider {
-  background-color: #0c0;
-}
-input:focus + .slider {
-  box-shadow: 0 0 1px #2196F3;
-}
-input:checked + .slider:before {
-  -webkit-transform: translateX(26px);
-  -ms-transform: translateX(26px);
-  transform: translateX(26px);
-}
-/* Rounded sliders */
-.slider.round {
-  border-radius: 34px;
-}
-.rotate0{display: inline-block; 
-}
-.rotate22{display: inline-block; 
-    -ms-transform: rotate(22.5deg); /* IE 9 */
-    -webkit-transform: rotate(22.5deg); /* Chrome, Safari, Opera */
-    transform: rotate(22.5deg);
-}
-.rotate45{display: inline-block; 
-    -ms-transform: rotate(45deg); /* IE 9 */
-    -webkit-transform: rotate(45deg); /* Chrome, Safari, Opera */
-    transform: rotate(45deg);
-}
-.rotate57{display: inline-block; 
-    -ms-transform: rotate(57deg); /* IE 9 */
-    -webkit-transform: rotate(57deg); /* Chrome, Safari, Opera */
-    transform: rotate(57deg);
-}
+// Generated by extras/html_template.py from HP_cntrl_Fancy_web.html and HP_cntrl_Fancy_web.css, do not edit
 
-.rotate67{display: inline-block; 
-    -ms-transform: rotate(67.5deg); /* IE 9 */
-    -webkit-transform: rotate(67.5deg); /* Chrome, Safari, Opera */
-    transform: rotate(67.5deg);
-}
+// placeholders, in order of first use
+enum htmlSlot : byte {
+  HTML_RATE,
+  HTML_ROOMTEMP,
+  HTML_POWER,
+  HTML_MODE_A,
+  HTML_MODE_D,
+  HTML_MODE_C,
+  HTML_MODE_H,
+  HTML_MODE_F,
+  HTML_FAN_A,
+  HTML_FAN_Q,
+  HTML_FAN_1,
+  HTML_FAN_2,
+  HTML_FAN_3,
+  HTML_FAN_4,
+  HTML_VANE_V,
+  HTML_VANE_C,
+  HTML_VANE_T,
+  HTML_WIDEVANE_V,
+  HTML_WIDEVANE_C,
+  HTML_WIDEVANE_T,
+  HTML_TEMP,
+  HTML_END
+};
 
-.rotate90{display: inline-block; 
-    -ms-transform: rotate(90deg); /* IE 9 */
-    -webkit-transform: rotate(90deg); /* Chrome, Safari, Opera */
-    transform: rotate(90deg);
-}
-.rotate124{display: inline-block; 
-    -ms-transform: rotate(124deg); /* IE 9 */
-    -webkit-transform: rotate(124deg); /* Chrome, Safari, Opera */
-    transform: rotate(124deg);
-}
-.rotate135{display: inline-block; 
-    -ms-transform: rotate(135deg); /* IE 9 */
-    -webkit-transform: rotate(135deg); /* Chrome, Safari, Opera */
-    transform: rotate(135deg);
-}
-.rotate157{display: inline-block; 
-    -ms-transform: rotate(157.5deg); /* IE 9 */
-    -webkit-transform: rotate(157.5deg); /* Chrome, Safari, Opera */
-    transform: rotate(157.5deg);
-}
-.rotate180{display: inline-block; 
-    -ms-transform: rotate(180deg); /* IE 9 */
-    -webkit-transform: rotate(180deg); /* Chrome, Safari, Opera */
-    transform: rotate(180deg);
-}
-.rotateV{
-    position: relative;
-    float: left;
-    animation-name:swingV;
-    animation-duration:5s;
-    animation-direction: alternate;
-    animation-iteration-count: infinite;
-    transform-origin:left center;
-}
-@-moz-keyframes swingV{
-    0%{-moz-transform:rotate(0deg)}
-    25%{-moz-transform:rotate(22.5deg)}
-    50%{-moz-transform:rotate(45deg)}
-    75%{-moz-transform:rotate(67.5deg)}
-    100%{-moz-transform:rotate(90deg)}
-}
-@-webkit-keyframes swingV{
-    0%{-webkit-transform:rotate(0deg)}
-    25%{-webkit-transform:rotate(22.5deg)}
-    50%{-webkit-transform:rotate(45deg)}
-    75%{-webkit-transform:rotate(67.5deg)}
-    100%{-webkit-transform:rotate(90deg)}
-}
-.rotateH{
-    position: relative;
-    float: left;
-    animation-name:swingH;
-    animation-duration:5s;
-    animation-direction: alternate;
-    animation-iteration-count: infinite;
-    transform-origin:center center;
-}
-@-moz-keyframes swingH{
-    0%{-moz-transform:rotate(22.5deg)}
-    25%{-moz-transform:rotate(57deg)}
-    50%{-moz-transform:rotate(90deg)}
-    75%{-moz-transform:rotate(124deg)}
-    100%{-moz-transform:rotate(157.5deg)}
-}
-@-webkit-keyframes swingH{
-    0%{-webkit-transform:rotate(22.5deg)}
-    25%{-webkit-transform:rotate(57deg)}
-    50%{-webkit-transform:rotate(90deg)}
-    75%{-webkit-transform:rotate(124deg)}
-    100%{-webkit-transform:rotate(157.5deg)}
-}
-.slider.round:before {
-  border-radius: 50%;
-}
-.hidden {visibility:hidden}
-.dropbtn {
-    background-color: transparent;
-    color: white;
-    border: none;
-    cursor: pointer;
-}
-.dropdown {
-    position: relative;
-    display: inline-block;
-}
-.dropdown-content {
-    display: none;
-    position: absolute;
-    background-color: #333;
-    padding: 5px;
-    box-shadow: 0px 8px 16px 0px rgba(0,0,0,0.2);
-    z-index: 1;
-}
-.dropdown-content label {
-    color: white;
-    text-decoration: none;
-    display: block;
-}
-.dropdown:hover .dropdown-content {
-    display: block;
-}
-table {width:100%;}
-table tr td:first-child{width:65px;}
-</style>
-<script>
-function changeVane(id,cls,txt,val)
-{
-  document.getElementById(id+"_").className=cls;
-  document.getElementById(id+"_").innerHTML=txt;
-  document.getElementById(id).value=val;
-  document.getElementById("F"+id+"_").submit();
-}
-function setTemp(b)
-{
-  var t = document.getElementById('TEMP');
-  if(b && t.value < 31)
-   { t.value++; }
-  else if(!b && t.value > 16)
-   { t.value--; }
-  document.getElementById("FTEMP_").submit();
-}
-</script>
-</head>
-<body>
-<table>
-<tr>
-<td>&#x1f321;</td><td>_ROOMTEMP_&deg;C</td> 
-<tr>
-<td>&#9889;&#65039;</td>
-<td> 
-  <form id="form" onchange="this.submit()">
-  <input name="PWRCHK" type="hidden" value="">
-  <label class="switch">
-    <input name="POWER" type="checkbox" value="ON" _POWER_>
-    <div class="sliderWidth slider round"></div>
-  </label>
-</form>
-</td>
-</tr>
-<tr>
-<td>&#9881;</td>
-<td> 
-<form onchange="this.submit()">  
-<label class="switch">
-  <input name="MODE" type="radio" value="AUTO" _MODE_A_>
-  <div class="selected auto">&#9851;</div>
-</label>
-<label class="switch">
-  <input name="MODE" type="radio" value="DRY" _MODE_D_>
-  <div class="selected">&#128167;</div>
-</label>
-<label class="switch">
-  <input name="MODE" type="radio" value="COOL" _MODE_C_>
-  <div class="selected">&#10052;&#65039;</div>
-</label>
-<label class="switch">
-  <input name="MODE" type="radio" value="HEAT" _MODE_H_>
-  <div class="selected">&#9728;&#65039;</div>
-</label>
-<label class="switch">
-  <input name="MODE" type="radio" value="FAN" _MODE_F_>
-  <div class="selected fan">&#10051;</div>
-</label>
-</form>
-</td>
-</tr>
-<tr>
-<td>&#127788;</td>
-<td>
-<form onchange="this.submit()">  
-<label class="switch">
-  <input name="FAN" type="radio" value="AUTO" _FAN_A_>
-  <div class="selected speed">&#9851;</div>
-</label>
-<label class="switch">
-  <input name="FAN" type="radio" value="QUIET" _FAN_Q_>
-  <div class="selected speed qspeed" style="width:20px;height:5px;">&#8230;</div>
-</label>
-<label class="switch"  style="">
-  <input name="FAN" type="radio" value="1" _FAN_1_>
-  <div class="selected speed"><div class="speedbar speed1"></div></div></div>
-</label>
-<label class="switch">
-  <input name="FAN" type="radio" value="2" _FAN_2_>
-  <div class="selected speed"><div class="speedbar speed2"></div></div>
-</label>
-<label class="switch">
-  <input name="FAN" type="radio" value="3" _FAN_3_>
-  <div class="selected speed"><div class="speedbar speed3"></div></div>
-</label>
-<label class="switch">
-  <input name="FAN" type="radio" value="4" _FAN_4_>
-  <div class="selected speed"><div class="speedbar speed4"></div></div>
-</label>
-</form>
-</td>
-</tr>
-<tr>
-<td>\</td>
-<td>  
-<div class="dropdown">
-  <form id="FVANE_"><input name="VANE" id="VANE" type="text" value="_VANE_V_"/></form>
-  <div class="_VANE_C_" id="VANE_">_VANE_T_</div>
-  <div class="dropdown-content">
-    <label><div class="" onclick="changeVane('VANE',this.className,this.innerHTML,'AUTO')">Auto</div></label>
-    <label><div class="rotate0" onclick="changeVane('VANE',this.className,this.innerHTML,1)">&#10143;</div></label>
-    <label><div class="rotate22" onclick="changeVane('VANE',this.className,this.innerHTML,2)">&#10143;</div></label>
-    <label><div class="rotate45" onclick="changeVane('VANE',this.className,this.innerHTML,3)">&#10143;</div></label>
-    <label><div class="rotate67" onclick="changeVane('VANE',this.className,this.innerHTML,4)">&#10143;</div></label>
-    <label><div class="rotate90" onclick="changeVane('VANE',this.className,this.innerHTML,5)">&#10143;</div></label>
-    <label><div class="" onclick="changeVane('VANE','rotateV','&#10143;','SWING')">Swing</div></label>
-  </div>
-</div>
+struct htmlSegment {
+  const char* text; // in flash
+  htmlSlot slot;    // filled in after text
+};
 
-</td>
-</tr>
-<tr>
-<td>=</td>
-<td> 
-<div class="dropdown">
-  <form id="FWIDEVANE_"><input name="WIDEVANE" id="WIDEVANE" type="text" value="_WIDEVANE_V_"/></form>
-  <div class="_WIDEVANE_C_" id="WIDEVANE_">_WIDEVANE_T_</div>
-  <div class="dropdown-content">
-    <label><div class="rotate157" onclick="changeVane('WIDEVANE',this.className,this.innerHTML,'<<')">&#10143;</div></label>
-    <label><div class="rotate124" onclick="changeVane('WIDEVANE',this.className,this.innerHTML,'<')">&#10143;</div></label>
-    <label><div class="rotate90" onclick="changeVane('WIDEVANE',this.className,this.innerHTML,'|')">&#10143;</div></label>
-    <label><div class="rotate57" onclick="changeVane('WIDEVANE',this.className,this.innerHTML,'>')">&#10143;</div></label>
-    <label><div class="rotate22" onclick="changeVane('WIDEVANE',this.className,this.innerHTML,'>>')">&#10143;</div></label>
-    <label><div class="" onclick="changeVane('WIDEVANE',this.className,this.innerHTML,'<>')">
-       <div class="rotate124">&#10143;</div>&nbsp;
-       <div class="rotate57">&#10143;</div>
-    </div></label>
-    <label><div class="" onclick="changeVane('WIDEVANE','rotateH','&#10143;','SWING')">Swing</div>
-  </div>
-</div>
-</td>
-</tr>
-<tr>
-<td>&#x1f321;</td>
-<td> 
-<input class="button" type='button' onclick="setTemp(0)" value="&#11015;"/>
-<form id="FTEMP_" style="display:inline"><input name="TEMP" id="TEMP" type="text" value="_TEMP_" style="width:20px"/></form>
-<input class="button" type='button' onclick="setTemp(1)" value="&#11014;"/>
-</td>
-</tr>
-</table>
-<center><form><input class="button" type='submit' name='CONNECT' value='Re-Connect'/></form></center>
-</body>
-</html>)====";
+static const char html_0[] PROGMEM =
+  "<!DOCTYPE html>\n"
+  "<html>\n"
+  "<head>\n"
+  "<meta name='viewport' content='width=device-width, initial-scale=1, user-scalable=yes'/>\n"
+  "<noscript><meta http-equiv='refresh' content='";
+static const char html_1[] PROGMEM =
+  "; url=/'/></noscript>\n"
+  "<link rel='stylesheet' href='/hp.css'/>\n"
+  "<script>\n"
+  "function changeVane(id,cls,txt,val)\n"
+  "{\n"
+  "  document.getElementById(id+\"_\").className=cls;\n"
+  "  document.getElementById(id+\"_\").innerHTML=txt;\n"
+  "  document.getElementById(id).value=val;\n"
+  "  document.getElementById(\"F\"+id+\"_\").submit();\n"
+  "}\n"
+  "function setTemp(b)\n"
+  "{\n"
+  "  var t = document.getElementById('TEMP');\n"
+  "  if(b && t.value < 31)\n"
+  "   { t.value++; }\n"
+  "  else if(!b && t.value > 16)\n"
+  "   { t.value--; }\n"
+  "  document.getElementById(\"FTEMP_\").submit();\n"
+  "}\n"
+  "function check(name,value)\n"
+  "{\n"
+  "  var input = document.querySelector(\"input[name='\"+name+\"'][value='\"+value+\"']\");\n"
+  "  if(input) { input.checked = true; }\n"
+  "}\n"
+  "// follow changes from /api/events instead of reloading every minute\n"
+  "function listen()\n"
+  "{\n"
+  "  if(!window.EventSource) { setTimeout(function() { location.reload(); }, 60000); return; }\n"
+  "  new EventSource('/api/events').addEventListener('state', function(e) {\n"
+  "    var s = JSON.parse(e.data);\n"
+  "    if(s.vane != document.getElementById('VANE').value || s.wideVane != document.getElementById('WIDEVANE').value)\n"
+  "     { location.reload(); return; }\n"
+  "    document.getElementById('ROOMTEMP_').innerHTML = s.roomTemperature.toFixed(2);\n"
+  "    document.getElementById('TEMP').value = s.temperature;\n"
+  "    document.querySelector(\"input[name='POWER']\").checked = s.power == 'ON';\n"
+  "    check('MODE', s.mode);\n"
+  "    check('FAN', s.fan);\n"
+  "  });\n"
+  "}\n"
+  "</script>\n"
+  "</head>\n"
+  "<body onload=\"listen()\">\n"
+  "<table>\n"
+  "<tr>\n"
+  "<td>&#x1f321;</td><td><span id=\"ROOMTEMP_\">";
+static const char html_2[] PROGMEM =
+  "</span>&deg;C</td> \n"
+  "<tr>\n"
+  "<td>&#9889;&#65039;</td>\n"
+  "<td> \n"
+  "  <form id=\"form\" onchange=\"this.submit()\">\n"
+  "  <input name=\"PWRCHK\" type=\"hidden\" value=\"\">\n"
+  "  <label class=\"switch\">\n"
+  "    <input name=\"POWER\" type=\"checkbox\" value=\"ON\" ";
+static const char html_3[] PROGMEM =
+  ">\n"
+  "    <div class=\"sliderWidth slider round\"></div>\n"
+  "  </label>\n"
+  "</form>\n"
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>&#9881;</td>\n"
+  "<td> \n"
+  "<form onchange=\"this.submit()\">  \n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"MODE\" type=\"radio\" value=\"AUTO\" ";
+static const char html_4[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected auto\">&#9851;</div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"MODE\" type=\"radio\" value=\"DRY\" ";
+static const char html_5[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected\">&#128167;</div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"MODE\" type=\"radio\" value=\"COOL\" ";
+static const char html_6[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected\">&#10052;&#65039;</div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"MODE\" type=\"radio\" value=\"HEAT\" ";
+static const char html_7[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected\">&#9728;&#65039;</div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"MODE\" type=\"radio\" value=\"FAN\" ";
+static const char html_8[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected fan\">&#10051;</div>\n"
+  "</label>\n"
+  "</form>\n"
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>&#127788;</td>\n"
+  "<td>\n"
+  "<form onchange=\"this.submit()\">  \n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"FAN\" type=\"radio\" value=\"AUTO\" ";
+static const char html_9[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected speed\">&#9851;</div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"FAN\" type=\"radio\" value=\"QUIET\" ";
+static const char html_10[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected speed qspeed\" style=\"width:20px;height:5px;\">&#8230;</div>\n"
+  "</label>\n"
+  "<label class=\"switch\"  style=\"\">\n"
+  "  <input name=\"FAN\" type=\"radio\" value=\"1\" ";
+static const char html_11[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected speed\"><div class=\"speedbar speed1\"></div></div></div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"FAN\" type=\"radio\" value=\"2\" ";
+static const char html_12[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected speed\"><div class=\"speedbar speed2\"></div></div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"FAN\" type=\"radio\" value=\"3\" ";
+static const char html_13[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected speed\"><div class=\"speedbar speed3\"></div></div>\n"
+  "</label>\n"
+  "<label class=\"switch\">\n"
+  "  <input name=\"FAN\" type=\"radio\" value=\"4\" ";
+static const char html_14[] PROGMEM =
+  ">\n"
+  "  <div class=\"selected speed\"><div class=\"speedbar speed4\"></div></div>\n"
+  "</label>\n"
+  "</form>\n"
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>\\</td>\n"
+  "<td>  \n"
+  "<div class=\"dropdown\">\n"
+  "  <form id=\"FVANE_\"><input name=\"VANE\" id=\"VANE\" type=\"text\" value=\"";
+static const char html_15[] PROGMEM =
+  "\"/></form>\n"
+  "  <div class=\"";
+static const char html_16[] PROGMEM =
+  "\" id=\"VANE_\">";
+static const char html_17[] PROGMEM =
+  "</div>\n"
+  "  <div class=\"dropdown-content\">\n"
+  "    <label><div class=\"\" onclick=\"changeVane('VANE',this.className,this.innerHTML,'AUTO')\">Auto</div></label>\n"
+  "    <label><div class=\"rotate0\" onclick=\"changeVane('VANE',this.className,this.innerHTML,1)\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate22\" onclick=\"changeVane('VANE',this.className,this.innerHTML,2)\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate45\" onclick=\"changeVane('VANE',this.className,this.innerHTML,3)\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate67\" onclick=\"changeVane('VANE',this.className,this.innerHTML,4)\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate90\" onclick=\"changeVane('VANE',this.className,this.innerHTML,5)\">&#10143;</div></label>\n"
+  "    <label><div class=\"\" onclick=\"changeVane('VANE','rotateV','&#10143;','SWING')\">Swing</div></label>\n"
+  "  </div>\n"
+  "</div>\n"
+  "\n"
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>=</td>\n"
+  "<td> \n"
+  "<div class=\"dropdown\">\n"
+  "  <form id=\"FWIDEVANE_\"><input name=\"WIDEVANE\" id=\"WIDEVANE\" type=\"text\" value=\"";
+static const char html_18[] PROGMEM =
+  "\"/></form>\n"
+  "  <div class=\"";
+static const char html_19[] PROGMEM =
+  "\" id=\"WIDEVANE_\">";
+static const char html_20[] PROGMEM =
+  "</div>\n"
+  "  <div class=\"dropdown-content\">\n"
+  "    <label><div class=\"rotate157\" onclick=\"changeVane('WIDEVANE',this.className,this.innerHTML,'<<')\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate124\" onclick=\"changeVane('WIDEVANE',this.className,this.innerHTML,'<')\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate90\" onclick=\"changeVane('WIDEVANE',this.className,this.innerHTML,'|')\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate57\" onclick=\"changeVane('WIDEVANE',this.className,this.innerHTML,'>')\">&#10143;</div></label>\n"
+  "    <label><div class=\"rotate22\" onclick=\"changeVane('WIDEVANE',this.className,this.innerHTML,'>>')\">&#10143;</div></label>\n"
+  "    <label><div class=\"\" onclick=\"changeVane('WIDEVANE',this.className,this.innerHTML,'<>')\">\n"
+  "       <div class=\"rotate124\">&#10143;</div>&nbsp;\n"
+  "       <div class=\"rotate57\">&#10143;</div>\n"
+  "    </div></label>\n"
+  "    <label><div class=\"\" onclick=\"changeVane('WIDEVANE','rotateH','&#10143;','SWING')\">Swing</div>\n"
+  "  </div>\n"
+  "</div>\n"
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>&#x1f321;</td>\n"
+  "<td> \n"
+  "<input class=\"button\" type='button' onclick=\"setTemp(0)\" value=\"&#11015;\"/>\n"
+  "<form id=\"FTEMP_\" style=\"display:inline\"><input name=\"TEMP\" id=\"TEMP\" type=\"text\" value=\"";
+static const char html_21[] PROGMEM =
+  "\" style=\"width:20px\"/></form>\n"
+  "<input class=\"button\" type='button' onclick=\"setTemp(1)\" value=\"&#11014;\"/>\n"
+  "</td>\n"
+  "</tr>\n"
+  "</table>\n"
+  "<center><form><input class=\"button\" type='submit' name='CONNECT' value='Re-Connect'/></form></center>\n"
+  "</body>\n"
+  "</html>";
+
+static const htmlSegment html_segments[] = {
+  {html_0, HTML_RATE},
+  {html_1, HTML_ROOMTEMP},
+  {html_2, HTML_POWER},
+  {html_3, HTML_MODE_A},
+  {html_4, HTML_MODE_D},
+  {html_5, HTML_MODE_C},
+  {html_6, HTML_MODE_H},
+  {html_7, HTML_MODE_F},
+  {html_8, HTML_FAN_A},
+  {html_9, HTML_FAN_Q},
+  {html_10, HTML_FAN_1},
+  {html_11, HTML_FAN_2},
+  {html_12, HTML_FAN_3},
+  {html_13, HTML_FAN_4},
+  {html_14, HTML_VANE_V},
+  {html_15, HTML_VANE_C},
+  {html_16, HTML_VANE_T},
+  {html_17, HTML_WIDEVANE_V},
+  {html_18, HTML_WIDEVANE_C},
+  {html_19, HTML_WIDEVANE_T},
+  {html_20, HTML_TEMP},
+  {html_21, HTML_END},
+};
+
+static const unsigned char style_gz[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xc5, 0x58, 0xdb, 0x6e, 0xe3, 0x36,
+  0x10, 0x7d, 0xf7, 0x57, 0x10, 0x1b, 0x2c, 0x90, 0x6c, 0x23, 0xaf, 0x2c, 0x4b, 0x4e, 0x2c, 0xbf,
+  0xb4, 0x48, 0xba, 0x9b, 0x3e, 0x15, 0x68, 0x81, 0x6d, 0x5f, 0x29, 0x89, 0xb6, 0x89, 0xc8, 0xa4,
+  0x4a, 0xd1, 0xb9, 0x19, 0xf9, 0xf7, 0x0e, 0x6f, 0x92, 0x6c, 0x4b, 0x76, 0x24, 0x14, 0x68, 0x8c,
+  0x20, 0xd6, 0x70, 0xce, 0xf0, 0xcc, 0xe8, 0x90, 0x19, 0x32, 0xe1, 0xd9, 0x2b, 0xda, 0xa5, 0x3c,
+  0xe7, 0x22, 0xbe, 0xb8, 0xbf, 0xbf, 0x5f, 0x2c, 0x39, 0x93, 0x5e, 0x49, 0xdf, 0x48, 0x1c, 0xfa,
+  0xc5, 0xcb, 0x22, 0xc1, 0xe9, 0xe3, 0x4a, 0xf0, 0x2d, 0xcb, 0xe2, 0x8b, 0xe9, 0x74, 0xba, 0x78,
+  0x1f, 0x8d, 0x93, 0xad, 0x94, 0x9c, 0xa1, 0xdd, 0x08, 0xc1, 0x4f, 0x3d, 0xee, 0x99, 0x20, 0xe8,
+  0x22, 0xbc, 0xfb, 0xe5, 0x5b, 0xe4, 0x2f, 0xd0, 0xd7, 0x2f, 0xe8, 0xbb, 0x20, 0x84, 0xa1, 0x2f,
+  0x5f, 0x8d, 0x2b, 0x17, 0x19, 0x01, 0x07, 0xc6, 0x19, 0x59, 0x68, 0x8b, 0x45, 0x3c, 0xaf, 0xa9,
+  0xb4, 0x96, 0x02, 0x67, 0x19, 0x65, 0xab, 0x18, 0x45, 0x30, 0xb7, 0xb6, 0x48, 0xf2, 0x22, 0x3d,
+  0x9c, 0xd3, 0x15, 0x8b, 0x51, 0x4a, 0x98, 0x24, 0xa2, 0x61, 0xcf, 0x48, 0xca, 0x05, 0x96, 0x94,
+  0xb3, 0x66, 0xd8, 0x8c, 0x96, 0x45, 0x8e, 0x5f, 0x63, 0x44, 0x59, 0x4e, 0x19, 0xf1, 0x92, 0x9c,
+  0xa7, 0x8f, 0x66, 0xa8, 0xce, 0x0e, 0x05, 0x7a, 0x0a, 0xc8, 0xa7, 0x7c, 0xa6, 0x32, 0x5d, 0xeb,
+  0x7c, 0x0a, 0x5e, 0x52, 0x13, 0x4d, 0x90, 0x1c, 0xe2, 0x3e, 0xe9, 0x88, 0x9d, 0xf1, 0xd6, 0x84,
+  0xae, 0xd6, 0x32, 0x46, 0xd3, 0xd0, 0x85, 0xca, 0x29, 0xa4, 0xf8, 0x17, 0xcd, 0xe4, 0x7a, 0x87,
+  0xd0, 0xb3, 0xfa, 0x1b, 0xa3, 0x99, 0xaa, 0x63, 0x3d, 0x0f, 0x65, 0xc5, 0x56, 0x5e, 0xa3, 0x71,
+  0x26, 0x78, 0x91, 0xf1, 0x67, 0x66, 0x0c, 0x68, 0xe7, 0x66, 0xd1, 0x79, 0x28, 0x77, 0x92, 0x93,
+  0x54, 0x92, 0x0c, 0x88, 0x79, 0xcf, 0x24, 0x79, 0xa4, 0xd2, 0x5b, 0xd2, 0x5c, 0xaa, 0x0a, 0xae,
+  0x04, 0x7e, 0x2d, 0x53, 0x9c, 0x93, 0xcb, 0x89, 0xef, 0x7f, 0xbe, 0x5a, 0x8c, 0x3a, 0x07, 0x1a,
+  0xd5, 0xb3, 0xc5, 0x7b, 0x1f, 0xe9, 0xf9, 0xe2, 0x74, 0x4d, 0xd2, 0x47, 0x88, 0xfe, 0x13, 0xfa,
+  0xd8, 0x4c, 0x1d, 0xf3, 0x28, 0x33, 0x90, 0x5d, 0x62, 0x06, 0x29, 0xe1, 0xad, 0xe4, 0x4e, 0x4b,
+  0xfe, 0x9d, 0x0f, 0xf6, 0x7f, 0xca, 0x82, 0xa8, 0xc0, 0xa6, 0x14, 0x81, 0xaa, 0x84, 0x2d, 0x5a,
+  0x64, 0x8b, 0xa2, 0xc6, 0x1d, 0x26, 0x8d, 0xa2, 0xca, 0x96, 0x60, 0xd1, 0x44, 0xa1, 0xa6, 0x10,
+  0x95, 0x5f, 0xf5, 0x56, 0xf6, 0x5e, 0x8a, 0x43, 0x4f, 0x76, 0x76, 0x1a, 0xbf, 0x39, 0x4f, 0xe0,
+  0xac, 0x13, 0xb0, 0x3a, 0xe3, 0xd4, 0x19, 0x83, 0x86, 0x31, 0x74, 0xc6, 0xa9, 0x35, 0xea, 0x17,
+  0x7b, 0xa0, 0x11, 0x9c, 0x94, 0x3c, 0xdf, 0x1a, 0xe9, 0xa6, 0x5b, 0x51, 0x2a, 0x2d, 0x17, 0x9c,
+  0x3a, 0x8d, 0x4a, 0x5e, 0xc4, 0xc8, 0x57, 0xdf, 0x72, 0xb2, 0x94, 0xf6, 0xab, 0x30, 0x8a, 0xd1,
+  0xdf, 0x13, 0x0e, 0x0b, 0x69, 0xe3, 0x1e, 0x8e, 0x17, 0x52, 0x9a, 0xa6, 0x6a, 0xc4, 0xbd, 0x13,
+  0x29, 0x30, 0x73, 0x53, 0x8f, 0xc3, 0x52, 0x4f, 0x71, 0x68, 0xaa, 0xa8, 0xc6, 0x09, 0x59, 0x72,
+  0x41, 0x4e, 0x31, 0x86, 0xa5, 0x00, 0x92, 0x88, 0xd1, 0xa7, 0x4f, 0x4d, 0x2d, 0x07, 0x33, 0xb3,
+  0xf2, 0xac, 0x78, 0xdd, 0xa3, 0x49, 0x21, 0x34, 0x0f, 0x8e, 0xb8, 0x7b, 0x3c, 0xa2, 0x5e, 0xad,
+  0xe8, 0x7e, 0xdc, 0x8f, 0x95, 0x59, 0x97, 0xbd, 0xa5, 0x3e, 0x7e, 0xea, 0xd7, 0xa8, 0x25, 0x4f,
+  0xb7, 0xe5, 0x21, 0x86, 0xbf, 0x78, 0xe5, 0x1a, 0xc3, 0x2a, 0x83, 0x22, 0xc3, 0x67, 0x52, 0xbc,
+  0xa0, 0x8b, 0x60, 0x32, 0x9f, 0x7d, 0x9b, 0x9e, 0x98, 0xae, 0x59, 0xba, 0x3d, 0xfe, 0x60, 0x85,
+  0xa4, 0xf5, 0x57, 0xd8, 0x1c, 0xc8, 0xdf, 0x97, 0xaa, 0x38, 0x57, 0x3a, 0xcd, 0x4d, 0x79, 0xce,
+  0xe5, 0xe4, 0xf0, 0xfb, 0x08, 0x36, 0xcb, 0x3f, 0x54, 0x72, 0x40, 0xc4, 0xb0, 0x28, 0xd5, 0xb6,
+  0x69, 0x19, 0x8d, 0x75, 0xde, 0x36, 0x25, 0xb5, 0x89, 0x7a, 0x02, 0x67, 0x74, 0x5b, 0x36, 0x76,
+  0x1e, 0xc1, 0x25, 0x04, 0xf4, 0x77, 0xed, 0x7b, 0x15, 0xaa, 0x5d, 0x82, 0xa0, 0xd3, 0x47, 0x6d,
+  0x90, 0x07, 0x99, 0x18, 0xcc, 0x65, 0x10, 0x8c, 0xa3, 0x8c, 0xac, 0xae, 0xf4, 0xa6, 0xfe, 0xdb,
+  0xaf, 0x68, 0xee, 0xf6, 0xf4, 0x96, 0xfa, 0xb4, 0x41, 0xee, 0xd6, 0x82, 0x6f, 0xc8, 0x35, 0xfa,
+  0x13, 0x2f, 0xb1, 0xa0, 0xd7, 0xe8, 0xf7, 0x82, 0x08, 0xec, 0x62, 0x9c, 0xc0, 0xd6, 0xb4, 0xc3,
+  0x68, 0x00, 0xed, 0xb0, 0x2f, 0xe9, 0x70, 0x30, 0xe5, 0xf0, 0x90, 0x70, 0x74, 0x33, 0x80, 0x70,
+  0x74, 0xd3, 0x93, 0x70, 0x03, 0xd0, 0x93, 0xb0, 0x45, 0x02, 0x61, 0xc7, 0x78, 0x36, 0x84, 0xf1,
+  0xec, 0xa6, 0xb7, 0x32, 0xf6, 0x20, 0x3d, 0x59, 0x57, 0xd8, 0x06, 0xef, 0xb9, 0x3f, 0x80, 0xf7,
+  0xdc, 0xef, 0xc9, 0xba, 0x01, 0xe8, 0xc9, 0xd9, 0x22, 0x6b, 0x69, 0x4c, 0x82, 0x70, 0x00, 0x63,
+  0x40, 0xf5, 0xa4, 0xdc, 0x44, 0xf4, 0xe4, 0xec, 0xa0, 0x0d, 0xd2, 0xd3, 0x21, 0x2b, 0x10, 0x50,
+  0x7d, 0x49, 0x4f, 0x07, 0x8b, 0xc3, 0x41, 0x1b, 0xa4, 0x07, 0xad, 0x42, 0x40, 0xf5, 0x16, 0xf5,
+  0x3e, 0xa6, 0x2f, 0xf1, 0xe8, 0xe6, 0x68, 0xc3, 0x9b, 0xdc, 0x0e, 0x91, 0x35, 0xa0, 0xfa, 0x12,
+  0xbf, 0x1d, 0x2c, 0x6c, 0x07, 0xad, 0x49, 0xff, 0x30, 0x87, 0x82, 0xf6, 0x36, 0x1a, 0xba, 0xef,
+  0x9c, 0x63, 0xe8, 0x22, 0x54, 0x2f, 0x61, 0x0c, 0x98, 0xd1, 0x8d, 0x6e, 0xdf, 0x3d, 0x86, 0x37,
+  0x24, 0x86, 0x0e, 0x99, 0xad, 0x7e, 0x1c, 0x0e, 0x65, 0x5b, 0xdb, 0xe2, 0x47, 0xe5, 0xd1, 0x10,
+  0x15, 0xd0, 0xb9, 0x9a, 0xd6, 0x46, 0x75, 0xa6, 0x0c, 0xbb, 0x83, 0x44, 0xed, 0x03, 0x9d, 0x88,
+  0xc1, 0x43, 0xdf, 0xb0, 0x55, 0xfd, 0x0e, 0x65, 0x4b, 0xca, 0xaa, 0x13, 0x47, 0x95, 0x96, 0xc7,
+  0xa1, 0x37, 0xa3, 0x2c, 0x56, 0xec, 0xaa, 0x93, 0xc6, 0xfb, 0xe8, 0x67, 0x6f, 0xc3, 0xdf, 0xbc,
+  0x47, 0xf2, 0xba, 0x14, 0x40, 0xb1, 0x44, 0x86, 0xa3, 0xc9, 0xd3, 0xff, 0xbc, 0xd3, 0xa3, 0x75,
+  0x69, 0x6c, 0x65, 0x74, 0x5d, 0xde, 0xb5, 0x4f, 0x10, 0x75, 0x39, 0xb9, 0xff, 0x72, 0xc6, 0x2f,
+  0xea, 0x0c, 0x16, 0x36, 0xbc, 0x6e, 0x3a, 0xa3, 0xb9, 0x9d, 0xd1, 0xf8, 0xa9, 0xf6, 0xbf, 0xc3,
+  0x71, 0x6e, 0xc9, 0xa9, 0xd4, 0xac, 0x2a, 0xba, 0xb3, 0x3b, 0x92, 0x4d, 0x47, 0x82, 0x5d, 0x7e,
+  0x2d, 0x39, 0x76, 0xb9, 0x1e, 0xa5, 0xd9, 0xe5, 0xd8, 0x96, 0x69, 0x97, 0x6f, 0x9d, 0xac, 0x55,
+  0xe8, 0xc3, 0x7f, 0xa0, 0xd0, 0x87, 0xff, 0x59, 0xa1, 0x46, 0x9c, 0xe7, 0x34, 0xfa, 0x70, 0x46,
+  0xa3, 0xfb, 0xaf, 0xa6, 0x5b, 0xa6, 0xa6, 0x51, 0x38, 0x27, 0xd2, 0xb9, 0xff, 0x11, 0x91, 0xda,
+  0x7f, 0x2b, 0x67, 0x35, 0x5a, 0x6d, 0x88, 0xa7, 0x64, 0xfa, 0x70, 0x5e, 0xa6, 0x2d, 0x39, 0x76,
+  0xb9, 0x1e, 0xa5, 0x79, 0x4e, 0x52, 0x67, 0x75, 0xda, 0x92, 0x6c, 0xa7, 0x6b, 0x33, 0xdf, 0xbd,
+  0xa6, 0xbf, 0x79, 0x18, 0x39, 0xe8, 0xfd, 0x81, 0xa5, 0xde, 0x7a, 0xd7, 0x34, 0xcb, 0x08, 0x43,
+  0xbb, 0x27, 0x5a, 0xd2, 0x84, 0xe6, 0x54, 0xbe, 0xc6, 0xc6, 0x04, 0x63, 0xea, 0x92, 0x21, 0x91,
+  0xdd, 0x97, 0x35, 0x9a, 0x49, 0x81, 0x05, 0x48, 0xa9, 0xeb, 0x4a, 0xa6, 0xe5, 0xda, 0xe6, 0xf0,
+  0xac, 0x6b, 0x27, 0xd2, 0xb7, 0x19, 0xa7, 0xd7, 0x57, 0xc7, 0x55, 0x4a, 0x23, 0x80, 0x67, 0xcf,
+  0xa5, 0x36, 0x50, 0x05, 0xa8, 0xa7, 0x6f, 0x3f, 0xce, 0xb6, 0x9e, 0x10, 0xd5, 0x8d, 0x55, 0xc7,
+  0xbd, 0xd2, 0xde, 0xd9, 0x10, 0xce, 0x85, 0xb7, 0xf0, 0x3b, 0x81, 0xd3, 0x98, 0x7e, 0x10, 0xab,
+  0x04, 0x5f, 0xfa, 0xd7, 0xfa, 0x33, 0x0e, 0xae, 0x0c, 0xe2, 0xcd, 0xa3, 0x70, 0x3e, 0x7b, 0x89,
+  0xd1, 0xa4, 0x9d, 0x70, 0x8e, 0x13, 0x92, 0x5b, 0xda, 0xc7, 0x65, 0xfc, 0xc8, 0x7d, 0xd5, 0x71,
+  0x35, 0xe2, 0x35, 0x7f, 0x82, 0xa5, 0x7e, 0xb6, 0x3a, 0x15, 0x52, 0xe2, 0x24, 0x27, 0xee, 0xbe,
+  0x45, 0x89, 0x6e, 0xe1, 0x6c, 0x52, 0x20, 0x99, 0xc5, 0x4b, 0x2a, 0x4a, 0xe9, 0xa5, 0x6b, 0x9a,
+  0x67, 0xd6, 0x69, 0x66, 0x6e, 0x48, 0xfe, 0x05, 0x7c, 0x7b, 0x46, 0xdc, 0x09, 0x14, 0x00, 0x00,
+};
@@ -3,6 +3,7 @@
 #include <ESP8266WebServer.h>
 #include <DNSServer.h>
 #include <HeatPump.h>
+#include <HeatPumpMetrics.h>
 #include "HP_cntrl_Fancy_web.h"
 
 const char* ssid = "HEATPUMP";
@@ -15,8 +16,127 @@ DNSServer dnsServer;
 ESP8266WebServer server(80);
 
 HeatPump hp;
+HeatPumpMetrics metrics(hp);
+
+// requests only stage changes, loop() sends them so no handler waits on the heat pump
+bool updatePending = false;
+bool connectPending = false;
+
+// open /api/events streams, sent the state whenever the snapshot version moves on
+const int EVENT_CLIENTS = 2;
+WiFiClient eventClients[EVENT_CLIENTS];
+unsigned long eventVersion = 0;
+
+const size_t STATE_JSON_LEN = 256;
+
+// part of the ETag: the snapshot version starts from 0 again after a reboot
+uint32_t bootId = 0;
+
+// the page goes out in chunks of this buffer, filled from the flash segments and the slot values
+class HtmlChunks {
+  private:
+    static const size_t CHUNK_LEN = 256;
+    char chunk[CHUNK_LEN];
+    size_t length = 0;
+
+    void put(char c) {
+      chunk[length++] = c;
+      if (length == CHUNK_LEN) {
+        flush();
+      }
+    }
+
+  public:
+    void write(const char* text) {
+      while (*text) {
+        put(*text++);
+      }
+    }
+
+    void write_P(PGM_P text) {
+      for (char c = pgm_read_byte(text); c; c = pgm_read_byte(++text)) {
+        put(c);
+      }
+    }
+
+    void write(float value) {
+      char text[12];
+      dtostrf(value, 1, 2, text);
+      write(text);
+    }
+
+    void flush() {
+      if (length > 0) {
+        server.sendContent(chunk, length);
+        length = 0;
+      }
+    }
+};
+
+// css class and text of the vane pictures, by setting
+struct vanePicture {
+  const char* setting;
+  const char* cssClass;
+  const char* text;
+};
+
+static const vanePicture vanePictures[] = {
+  {"AUTO", "rotate0", "AUTO"}, {"1", "rotate0", "&#10143;"}, {"2", "rotate22", "&#10143;"},
+  {"3", "rotate45", "&#10143;"}, {"4", "rotate67", "&#10143;"}, {"5", "rotate90", "&#10143;"},
+  {"SWING", "rotateV", "&#10143;"}, {nullptr, "", ""}
+};
+
+static const vanePicture wideVanePictures[] = {
+  {"<<", "rotate157", "&#10143;"}, {"<", "rotate124", "&#10143;"}, {"|", "rotate90", "&#10143;"},
+  {">", "rotate57", "&#10143;"}, {">>", "rotate22", "&#10143;"},
+  {"<>", "", "<div class='rotate124'>&#10143;</div>&nbsp;<div class='rotate57'>&#10143;</div>"},
+  {"SWING", "rotateH", "&#10143;"}, {nullptr, "", ""}
+};
+
+// the entry for setting, or the empty one at the end
+const vanePicture& findPicture(const vanePicture* pictures, const char* setting) {
+  while (pictures->setting && (!setting || strcmp(pictures->setting, setting) != 0)) {
+    pictures++;
+  }
+  return *pictures;
+}
+
+void writeChecked(HtmlChunks& page, const char* setting, const char* value) {
+  if (setting && strcmp(setting, value) == 0) {
+    page.write("checked");
+  }
+}
+
+void writeSlot(HtmlChunks& page, htmlSlot slot, const heatpumpSettings& settings) {
+  switch (slot) {
+    case HTML_RATE:       page.write("60"); break;
+    case HTML_ROOMTEMP:   page.write(hp.getRoomTemperature()); break;
+    case HTML_POWER:      writeChecked(page, settings.power, "ON"); break;
+    case HTML_MODE_A:     writeChecked(page, settings.mode, "AUTO"); break;
+    case HTML_MODE_D:     writeChecked(page, settings.mode, "DRY"); break;
+    case HTML_MODE_C:     writeChecked(page, settings.mode, "COOL"); break;
+    case HTML_MODE_H:     writeChecked(page, settings.mode, "HEAT"); break;
+    case HTML_MODE_F:     writeChecked(page, settings.mode, "FAN"); break;
+    case HTML_FAN_A:      writeChecked(page, settings.fan, "AUTO"); break;
+    case HTML_FAN_Q:      writeChecked(page, settings.fan, "QUIET"); break;
+    case HTML_FAN_1:      writeChecked(page, settings.fan, "1"); break;
+    case HTML_FAN_2:      writeChecked(page, settings.fan, "2"); break;
+    case HTML_FAN_3:      writeChecked(page, settings.fan, "3"); break;
+    case HTML_FAN_4:      writeChecked(page, settings.fan, "4"); break;
+    case HTML_VANE_V:     page.write(settings.vane ? settings.vane : ""); break;
+    case HTML_VANE_C:     page.write(findPicture(vanePictures, settings.vane).cssClass); break;
+    case HTML_VANE_T:     page.write(findPicture(vanePictures, settings.vane).text); break;
+    case HTML_WIDEVANE_V: page.write(settings.wideVane ? settings.wideVane : ""); break;
+    case HTML_WIDEVANE_C: page.write(findPicture(wideVanePictures, settings.wideVane).cssClass); break;
+    case HTML_WIDEVANE_T: page.write(findPicture(wideVanePictures, settings.wideVane).text); break;
+    case HTML_TEMP:       page.write(hp.getTemperature()); break;
+    case HTML_END:        break;
+  }
+}
 
 void setup() {
+  bootId = ESP.random(); // hardware random number
+  hp.enableSnapshots();
   hp.connect(&Serial);
   hp.setSettings({ //set some default settings
     "ON",  /* ON/OFF */
@@ -33,6 +153,14 @@ void setup() {
   dnsServer.start(DNS_PORT, "*", apIP);
   server.on("/", handle_root);
   server.on("/generate_204", handle_root);
+  server.on("/hp.css", handle_style);
+  server.on("/api/state", HTTP_GET, handle_state);
+  server.on("/api/settings", HTTP_POST, handle_settings);
+  server.on("/api/events", HTTP_GET, handle_events);
+  server.on("/metrics", HTTP_GET, handle_metrics);
+  metrics.addGauge("heatpump_free_heap_bytes", "Free heap.", []() -> unsigned long { return ESP.getFreeHeap(); });
+  const char* headers[] = {"If-None-Match"};
+  server.collectHeaders(headers, 1);
   server.onNotFound(handleNotFound);
   server.begin();
 }
@@ -40,7 +168,18 @@ void setup() {
 void loop() {
   dnsServer.processNextRequest();
   server.handleClient();
+
+  if (connectPending) {
+    connectPending = false;
+    hp.connect(&Serial);
+  }
+  if (updatePending) {
+    updatePending = false;
+    hp.update();
+  }
   hp.sync();
+
+  sendEvents();
 }
 
 
@@ -49,143 +188,153 @@ void handleNotFound() {
 }
 
 void handle_root() {
-  heatpumpSettings settings = hp.getSettings();
-  settings = change_states(settings);
-  String toSend = html;
-  toSend.replace("_RATE_", "60");
-  toSend.replace("_ROOMTEMP_", String(hp.getRoomTemperature()));
-  toSend.replace("_POWER_", strcmp(settings.power, "ON") == 0 ? "checked" : "");
-  if(strcmp(settings.mode, "HEAT") == 0) {
-    toSend.replace("_MODE_H_","checked");
-  }
-  else if(strcmp(settings.mode, "DRY") == 0) {
-    toSend.replace("_MODE_D_","checked");
-  }
-  else if(strcmp(settings.mode, "COOL") == 0) {
-    toSend.replace("_MODE_C_","checked");
-  }
-  else if(strcmp(settings.mode, "FAN") == 0) {
-    toSend.replace("_MODE_F_","checked");
-  }
-  else if(strcmp(settings.mode, "AUTO") == 0) {
-    toSend.replace("_MODE_A_","checked");
-  }
-  if(strcmp(settings.fan, "AUTO") == 0) {
-    toSend.replace("_FAN_A_","checked");
-  }
-  else if(strcmp(settings.fan, "QUIET") == 0) {
-    toSend.replace("_FAN_Q_","checked");
-  }
-  else if(strcmp(settings.fan, "1") == 0) {
-    toSend.replace("_FAN_1_","checked");
-  }
-  else if(strcmp(settings.fan, "2") == 0) {
-    toSend.replace("_FAN_2_","checked");
-  }
-  else if(strcmp(settings.fan, "3") == 0) {
-    toSend.replace("_FAN_3_","checked");
-  }
-  else if(strcmp(settings.fan, "4") == 0) {
-    toSend.replace("_FAN_4_","checked");
-  }
- 
-  toSend.replace("_VANE_V_",settings.vane);
-  if(strcmp(settings.vane, "AUTO") == 0) {
-    toSend.replace("_VANE_C_","rotate0");
-    toSend.replace("_VANE_T_","AUTO");
-  }
-  else if(strcmp(settings.vane, "1") == 0) {
-    toSend.replace("_VANE_C_","rotate0");
-    toSend.replace("_VANE_T_","&#10143;");
-  }
-  else if(strcmp(settings.vane, "2") == 0) {
-    toSend.replace("_VANE_C_","rotate22");
-    toSend.replace("_VANE_T_","&#10143;");
+  change_states();
+  // what was asked for, the unit reports it back once it took it
+  heatpumpSettings settings = hp.getWantedSettings();
+
+  // chunked, the length is not known until the slots are filled in
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/html", "");
+  HtmlChunks page;
+  for (const htmlSegment& segment : html_segments) {
+    page.write_P(segment.text);
+    writeSlot(page, segment.slot, settings);
   }
-  else if(strcmp(settings.vane, "3") == 0) {
-    toSend.replace("_VANE_C_","rotate45");
-    toSend.replace("_VANE_T_","&#10143;");
+  page.flush();
+  server.sendContent("");
+}
+
+void handle_style() {
+  // static, so the browser keeps it across the page refreshes
+  server.sendHeader("Content-Encoding", "gzip");
+  server.sendHeader("Cache-Control", "max-age=86400");
+  server.send_P(200, "text/css", (PGM_P)style_gz, sizeof(style_gz));
+}
+
+// stages the settings given as request arguments with these names
+bool stageSettings(const char* modeArg, const char* tempArg, const char* fanArg, const char* vaneArg, const char* wideVaneArg) {
+  bool staged = false;
+  if (server.hasArg(modeArg)) {
+    hp.setModeSetting(server.arg(modeArg).c_str());
+    staged = true;
   }
-  else if(strcmp(settings.vane, "4") == 0) {
-    toSend.replace("_VANE_C_","rotate67");
-    toSend.replace("_VANE_T_","&#10143;");
+  if (server.hasArg(tempArg)) {
+    hp.setTemperature(server.arg(tempArg).toFloat());
+    staged = true;
   }
-  else if(strcmp(settings.vane, "5") == 0) {
-    toSend.replace("_VANE_C_","rotate90");
-    toSend.replace("_VANE_T_","&#10143;");
+  if (server.hasArg(fanArg)) {
+    hp.setFanSpeed(server.arg(fanArg).c_str());
+    staged = true;
   }
-  else if(strcmp(settings.vane, "SWING") == 0) {
-    toSend.replace("_VANE_C_","rotateV");
-    toSend.replace("_VANE_T_","&#10143;");
+  if (server.hasArg(vaneArg)) {
+    hp.setVaneSetting(server.arg(vaneArg).c_str());
+    staged = true;
   }
-  toSend.replace("_WIDEVANE_V_",settings.wideVane);
-  if(strcmp(settings.wideVane, "<<") == 0) {
-    toSend.replace("_WIDEVANE_C_","rotate157");
-    toSend.replace("_WIDEVANE_T_","&#10143;");
+  if (server.hasArg(wideVaneArg)) {
+    hp.setWideVaneSetting(server.arg(wideVaneArg).c_str());
+    staged = true;
   }
-  else if(strcmp(settings.wideVane, "<") == 0) {
-    toSend.replace("_WIDEVANE_C_","rotate124");
-    toSend.replace("_WIDEVANE_T_","&#10143;");
+  updatePending = updatePending || staged;
+  return staged;
+}
+
+void change_states() {
+  if (server.hasArg("CONNECT")) {
+    connectPending = true;
+    return;
   }
-  else if(strcmp(settings.wideVane, "|") == 0) {
-    toSend.replace("_WIDEVANE_C_","rotate90");
-    toSend.replace("_WIDEVANE_T_","&#10143;");
+  if (server.hasArg("PWRCHK")) {
+    hp.setPowerSetting(server.hasArg("POWER"));
+    updatePending = true;
   }
-  else if(strcmp(settings.wideVane, ">") == 0) {
-    toSend.replace("_WIDEVANE_C_","rotate57");
-    toSend.replace("_WIDEVANE_T_","&#10143;");
+  stageSettings("MODE", "TEMP", "FAN", "VANE", "WIDEVANE");
+}
+
+size_t writeStateJson(char* json, size_t size, const heatpumpSnapshot& snapshot) {
+  const heatpumpSettings& settings = snapshot.settings;
+  int length = snprintf(json, size,
+    "{\"version\":%lu,\"connected\":%s,\"power\":\"%s\",\"mode\":\"%s\",\"temperature\":%.1f,"
+    "\"fan\":\"%s\",\"vane\":\"%s\",\"wideVane\":\"%s\",\"roomTemperature\":%.1f,\"operating\":%s}",
+    snapshot.version, snapshot.connected ? "true" : "false",
+    settings.power ? settings.power : "", settings.mode ? settings.mode : "", settings.temperature,
+    settings.fan ? settings.fan : "", settings.vane ? settings.vane : "", settings.wideVane ? settings.wideVane : "",
+    snapshot.status.roomTemperature, snapshot.status.operating ? "true" : "false");
+  return length < (int)size ? length : size - 1;
+}
+
+// current state, the ETag is the boot and the snapshot version so polling clients get a 304 until something changed
+void handle_state() {
+  heatpumpSnapshot snapshot {}; // stays empty, version 0, until the first sync()
+  hp.getSnapshot(snapshot);
+
+  char etag[24];
+  snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)bootId, snapshot.version);
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+  if (server.header("If-None-Match") == etag) {
+    server.send(304);
+    return;
   }
-  else if(strcmp(settings.wideVane, ">>") == 0) {
-    toSend.replace("_WIDEVANE_C_","rotate22");
-    toSend.replace("_WIDEVANE_T_","&#10143;");
+
+  char json[STATE_JSON_LEN];
+  writeStateJson(json, sizeof(json), snapshot);
+  server.send(200, "application/json", json);
+}
+
+// power, mode, temperature, fan, vane and wideVane as form fields, sent from loop()
+void handle_settings() {
+  bool staged = false;
+  if (server.hasArg("power")) {
+    hp.setPowerSetting(server.arg("power").c_str());
+    updatePending = true;
+    staged = true;
   }
-  else if(strcmp(settings.wideVane, "<>") == 0) {
-    toSend.replace("_WIDEVANE_C_","");
-    toSend.replace("_WIDEVANE_T_","<div class='rotate124'>&#10143;</div>&nbsp;<div class='rotate57'>&#10143;</div>");
+  staged = stageSettings("mode", "temperature", "fan", "vane", "wideVane") || staged;
+  if (!staged) {
+    server.send(400, "application/json", "{\"error\":\"no settings\"}");
+    return;
   }
-  else if(strcmp(settings.wideVane, "SWING") == 0) {
-    toSend.replace("_WIDEVANE_C_","rotateH");
-    toSend.replace("_WIDEVANE_T_","&#10143;");
+  server.send(202, "application/json", "{\"queued\":true}");
+}
+
+// for Prometheus, streamed from the metrics' chunk buffer after the headers
+void handle_metrics() {
+  metrics.capture();
+  server.setContentLength(metrics.length());
+  server.send(200, "text/plain; version=0.0.4", "");
+  WiFiClient client = server.client();
+  metrics.write(client);
+}
+
+// server-sent events, kept open and written to from loop()
+void handle_events() {
+  for (int i = 0; i < EVENT_CLIENTS; i++) {
+    if (!eventClients[i].connected()) {
+      eventClients[i] = server.client();
+      eventClients[i].setNoDelay(true);
+      eventClients[i].print(F("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                              "Cache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n"));
+      eventVersion = 0; // the new listener gets the state right away
+      return;
+    }
   }
-  toSend.replace("_TEMP_", String(hp.getTemperature()));
-  server.send(200, "text/html", toSend);
-  delay(100);
+  server.send(503, "text/plain", "Too many listeners");
 }
 
-heatpumpSettings change_states(heatpumpSettings settings) {
-  if (server.hasArg("CONNECT")) {
-    hp.connect(&Serial);
+void sendEvents() {
+  heatpumpSnapshot snapshot;
+  if (!hp.getSnapshot(snapshot, eventVersion)) {
+    return;
   }
-  else {
-    bool update = false;
-    if (server.hasArg("PWRCHK")) {
-      settings.power=server.hasArg("POWER") ? "ON" : "OFF";
-      update = true;
-    }
-    if (server.hasArg("MODE")) {
-      settings.mode=server.arg("MODE").c_str();
-      update = true;
-    }
-    if (server.hasArg("TEMP")) {
-      settings.temperature=server.arg("TEMP").toInt();
-      update = true;
-    }
-    if (server.hasArg("FAN")) {
-      settings.fan=server.arg("FAN").c_str();
-      update = true;
-    }
-    if (server.hasArg("VANE")) {
-      settings.vane=server.arg("VANE").c_str();
-      update = true;
-    }
-    if (server.hasArg("WIDEVANE")) {
-      settings.wideVane=server.arg("WIDEVANE").c_str();
-      update = true;
+  eventVersion = snapshot.version;
+
+  char json[STATE_JSON_LEN];
+  size_t length = writeStateJson(json, sizeof(json), snapshot);
+  for (int i = 0; i < EVENT_CLIENTS; i++) {
+    if (eventClients[i].connected()) {
+      eventClients[i].print(F("event: state\ndata: "));
+      eventClients[i].write((const uint8_t*)json, length);
+      eventClients[i].print(F("\n\n"));
     }
-    if(update) {
-      hp.setSettings(settings);
-      hp.update();
-    } 
   }
-  return settings;
 }
@@ -0,0 +1,85 @@
+// Generated by extras/html_template.py from HP_cntrl_esp8266.html, do not edit
+
+// placeholders, in order of first use
+enum htmlSlot : byte {
+  HTML_RATE,
+  HTML_ROOMTEMP,
+  HTML_POWER,
+  HTML_MODE,
+  HTML_TEMP,
+  HTML_FAN,
+  HTML_VANE,
+  HTML_WVANE,
+  HTML_END
+};
+
+struct htmlSegment {
+  const char* text; // in flash
+  htmlSlot slot;    // filled in after text
+};
+
+static const char html_0[] PROGMEM =
+  "<html>\n"
+  "<head>\n"
+  "<meta name='viewport' content='width=device-width, initial-scale=2'/>\n"
+  "<meta http-equiv='refresh' content='";
+static const char html_1[] PROGMEM =
+  "; url=/'/>\n"
+  "<style></style>\n"
+  "<body><h3>Heat Pump Demo</h3>TEMP: ";
+static const char html_2[] PROGMEM =
+  "\n"
+  "&deg;C<form autocomplete='off' method='post' action=''>\n"
+  "<table>\n"
+  "<tr>\n"
+  "<td>Power:</td>\n"
+  "<td>\n";
+static const char html_3[] PROGMEM =
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>Mode:</td>\n"
+  "<td>\n";
+static const char html_4[] PROGMEM =
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>Temp:</td>\n"
+  "<td>\n";
+static const char html_5[] PROGMEM =
+  "</td>\n"
+  "</tr><tr>\n"
+  "<td>Fan:</td>\n"
+  "<td>\n";
+static const char html_6[] PROGMEM =
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>Vane:</td><td>\n";
+static const char html_7[] PROGMEM =
+  "</td>\n"
+  "</tr>\n"
+  "<tr>\n"
+  "<td>WideVane:</td>\n"
+  "<td>\n";
+static const char html_8[] PROGMEM =
+  "</td>\n"
+  "</tr>\n"
+  "</table>\n"
+  "<br/><input type='submit' value='Change Settings'/>\n"
+  "</form><br/><br/><form><input type='submit' name='CONNECT' value='Re-Connect'/>\n"
+  "</form>\n"
+  "</body>\n"
+  "</html>\n";
+
+static const htmlSegment html_segments[] = {
+  {html_0, HTML_RATE},
+  {html_1, HTML_ROOMTEMP},
+  {html_2, HTML_POWER},
+  {html_3, HTML_MODE},
+  {html_4, HTML_TEMP},
+  {html_5, HTML_FAN},
+  {html_6, HTML_VANE},
+  {html_7, HTML_WVANE},
+  {html_8, HTML_END},
+};
@@ -3,23 +3,10 @@
 #include <ESP8266WebServer.h>
 #include <DNSServer.h>
 #include <HeatPump.h>
+#include "HP_cntrl_esp8266.h"
 
 const char* ssid = "esp8266";
 
-const char* html = "<html>\n<head>\n<meta name='viewport' content='width=device-width, initial-scale=2'/>\n"
-                   "<meta http-equiv='refresh' content='_RATE_; url=/'/>\n"
-                   "<style></style>\n"
-                   "<body><h3>Heat Pump Demo</h3>TEMP: _ROOMTEMP_\n&deg;C<form autocomplete='off' method='post' action=''>\n<table>\n"
-                   "<tr>\n<td>Power:</td>\n<td>\n_POWER_</td>\n</tr>\n"
-                   "<tr>\n<td>Mode:</td>\n<td>\n_MODE_</td>\n</tr>\n"
-                   "<tr>\n<td>Temp:</td>\n<td>\n_TEMP_</td>\n</tr>"
-                   "<tr>\n<td>Fan:</td>\n<td>\n_FAN_</td>\n</tr>\n"
-                   "<tr>\n<td>Vane:</td><td>\n_VANE_</td>\n</tr>\n"
-                   "<tr>\n<td>WideVane:</td>\n<td>\n_WVANE_</td>\n</tr>\n"
-                   "</table>\n<br/><input type='submit' value='Change Settings'/>\n</form><br/><br/>"
-                   "<form><input type='submit' name='CONNECT' value='Re-Connect'/>\n</form>\n"
-                   "</body>\n</html>\n";
-
 const byte DNS_PORT = 53;
 IPAddress apIP(192, 168, 1, 1);
 IPAddress netMsk(255, 255, 255, 0);
@@ -28,6 +15,117 @@ ESP8266WebServer server(80);
 
 HeatPump hp;
 
+// requests only stage changes, loop() sends them so no handler waits on the heat pump
+bool updatePending = false;
+bool connectPending = false;
+
+// the page goes out in chunks of this buffer, filled from the flash segments and the slot values
+class HtmlChunks {
+  private:
+    static const size_t CHUNK_LEN = 256;
+    char chunk[CHUNK_LEN];
+    size_t length = 0;
+
+    void put(char c) {
+      chunk[length++] = c;
+      if (length == CHUNK_LEN) {
+        flush();
+      }
+    }
+
+  public:
+    void write(const char* text) {
+      while (*text) {
+        put(*text++);
+      }
+    }
+
+    void write_P(PGM_P text) {
+      for (char c = pgm_read_byte(text); c; c = pgm_read_byte(++text)) {
+        put(c);
+      }
+    }
+
+    // for option labels, the vane settings use <, > and |
+    void writeEncoded(const char* text) {
+      for (; *text; text++) {
+        switch (*text) {
+          case '<': write("&lt;"); break;
+          case '>': write("&gt;"); break;
+          case '|': write("&vert;"); break;
+          default: put(*text);
+        }
+      }
+    }
+
+    void write(float value) {
+      char text[12];
+      dtostrf(value, 1, 2, text);
+      write(text);
+    }
+
+    void flush() {
+      if (length > 0) {
+        server.sendContent(chunk, length);
+        length = 0;
+      }
+    }
+};
+
+static const char* const powerOptions[] = {"OFF", "ON"};
+static const char* const modeOptions[] = {"HEAT", "DRY", "COOL", "FAN", "AUTO"};
+static const char* const tempOptions[] = {"31", "30", "29", "28", "27", "26", "25", "24", "23", "22", "21", "20", "19", "18", "17", "16"};
+static const char* const fanOptions[] = {"AUTO", "QUIET", "1", "2", "3", "4"};
+static const char* const vaneOptions[] = {"AUTO", "1", "2", "3", "4", "5", "SWING"};
+static const char* const wideVaneOptions[] = {"<<", "<", "|", ">", ">>", "<>", "SWING"};
+
+void writeSelector(HtmlChunks& page, const char* name, const char* const values[], int len, const char* value) {
+  page.write("<select name='");
+  page.write(name);
+  page.write("'>\n");
+  for (int i = 0; i < len; i++) {
+    page.write("<option value='");
+    page.write(values[i]);
+    page.write(value && strcmp(values[i], value) == 0 ? "' selected>" : "'>");
+    page.writeEncoded(values[i]);
+    page.write("</option>\n");
+  }
+  page.write("</select>\n");
+}
+
+void writeSlot(HtmlChunks& page, htmlSlot slot, bool updated) {
+  char temp[3];
+  switch (slot) {
+    case HTML_RATE:
+      page.write(updated ? "0" : "60"); // reload at once to show what the unit took
+      break;
+    case HTML_ROOMTEMP:
+      page.write(hp.getRoomTemperature());
+      break;
+    case HTML_POWER:
+      writeSelector(page, "POWER", powerOptions, 2, hp.getPowerSetting());
+      break;
+    case HTML_MODE:
+      writeSelector(page, "MODE", modeOptions, 5, hp.getModeSetting());
+      break;
+    case HTML_TEMP:
+      snprintf(temp, sizeof(temp), "%d", (int)hp.getTemperature()); // whole degrees only
+      writeSelector(page, "TEMP", tempOptions, 16, temp);
+      break;
+    case HTML_FAN:
+      writeSelector(page, "FAN", fanOptions, 6, hp.getFanSpeed());
+      break;
+    case HTML_VANE:
+      writeSelector(page, "VANE", vaneOptions, 7, hp.getVaneSetting());
+      break;
+    case HTML_WVANE:
+      writeSelector(page, "WIDEVANE", wideVaneOptions, 7, hp.getWideVaneSetting());
+      break;
+    case HTML_END:
+      break;
+  }
+}
+
 void setup() {
   hp.connect(&Serial);
   hp.setSettings({ //set some default settings
@@ -52,30 +150,16 @@ void setup() {
 void loop() {
   dnsServer.processNextRequest();
   server.handleClient();
-  hp.sync();
-}
 
-String encodeString(String toEncode) {
-  toEncode.replace("<", "&lt;");
-  toEncode.replace(">", "&gt;");
-  toEncode.replace("|", "&vert;");
-  return toEncode;
-}
-
-String createOptionSelector(String name, const String values[], int len, String value) {
-  String str = "<select name='" + name + "'>\n";
-  for (int i = 0; i < len; i++) {
-    String encoded = encodeString(values[i]);
-    str += "<option value='";
-    str += values[i];
-    str += "'";
-    str += values[i] == value ? " selected" : "";
-    str += ">";
-    str += encoded;
-    str += "</option>\n";
+  if (connectPending) {
+    connectPending = false;
+    hp.connect(&Serial);
+  }
+  if (updatePending) {
+    updatePending = false;
+    hp.update();
   }
-  str += "</select>\n";
-  return str;
+  hp.sync();
 }
 
 void handleNotFound() {
@@ -83,30 +167,24 @@ void handleNotFound() {
 }
 
 void handle_root() {
-  int rate = change_states() ? 0 : 60;
-  String toSend = html;
-  toSend.replace("_RATE_", String(rate));
-  String power[2] = {"OFF", "ON"}; 
-  toSend.replace("_POWER_", createOptionSelector("POWER", power, 2, hp.getPowerSetting()));
-  String mode[5] = {"HEAT", "DRY", "COOL", "FAN", "AUTO"};
-  toSend.replace("_MODE_", createOptionSelector("MODE", mode, 5, hp.getModeSetting()));
-  String temp[16] = {"31", "30", "29", "28", "27", "26", "25", "24", "23", "22", "21", "20", "19", "18", "17", "16"};
-  toSend.replace("_TEMP_", createOptionSelector("TEMP", temp, 16, String(hp.getTemperature()).substring(0,2)));
-  String fan[6] = {"AUTO", "QUIET", "1", "2", "3", "4"};
-  toSend.replace("_FAN_", createOptionSelector("FAN", fan, 6, hp.getFanSpeed()));
-  String vane[7] = {"AUTO", "1", "2", "3", "4", "5", "SWING"};
-  toSend.replace("_VANE_", createOptionSelector("VANE", vane, 7, hp.getVaneSetting()));
-  String widevane[7] = {"<<", "<", "|", ">", ">>", "<>", "SWING"}; 
-  toSend.replace("_WVANE_", createOptionSelector("WIDEVANE", widevane, 7, hp.getWideVaneSetting()));
-  toSend.replace("_ROOMTEMP_", String(hp.getRoomTemperature()));
-  server.send(200, "text/html", toSend);
-  delay(100);
+  bool updated = change_states();
+
+  // chunked, the length is not known until the slots are filled in
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/html", "");
+  HtmlChunks page;
+  for (const htmlSegment& segment : html_segments) {
+    page.write_P(segment.text);
+    writeSlot(page, segment.slot, updated);
+  }
+  page.flush();
+  server.sendContent("");
 }
 
 bool change_states() {
   bool updated = false;
   if (server.hasArg("CONNECT")) {
-    hp.connect(&Serial);
+    connectPending = true;
   }
   else {
     if (server.hasArg("POWER")) {
@@ -129,11 +207,11 @@ bool change_states() {
       hp.setVaneSetting(server.arg("VANE").c_str());
       updated = true;
     }
-    if (server.hasArg("DIR")) {
+    if (server.hasArg("WIDEVANE")) {
       hp.setWideVaneSetting(server.arg("WIDEVANE").c_str());
       updated = true;
     }
-    hp.update(); 
+    updatePending = updatePending || updated;
   }
   return updated;
 }
@@ -16,9 +16,13 @@ void setup() {
   };
   hp.setSettings(mySettings);
   hp.update();
+#if HEATPUMP_ENABLE_IDLE_MODE
+  hp.enableIdleMode(); // poll slowly while the heat pump is off
+#endif
 }
 
 void loop() {
   // put your main code here, to run repeatedly:
   hp.sync();
+  delay(hp.getSleepTime()); // nothing to do until then, lets the board save power
 }
\ No newline at end of file
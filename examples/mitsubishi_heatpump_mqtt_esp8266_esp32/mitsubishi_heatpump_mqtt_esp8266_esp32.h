@@ -16,17 +16,26 @@ const char* mqtt_password = "<YOUR MQTT PASSWORD GOES HERE>";
 // mqtt client settings
 // Note PubSubClient.h has a MQTT_MAX_PACKET_SIZE of 128 defined, so either raise it to 256 or use short topics
 const char* client_id                   = "heatpump"; // Must be unique on the MQTT network
-const char* heatpump_topic              = "heatpump";
-const char* heatpump_set_topic          = "heatpump/set";
-const char* heatpump_status_topic       = "heatpump/status";
-const char* heatpump_timers_topic       = "heatpump/timers";
-
-const char* heatpump_debug_topic        = "heatpump/debug";
-const char* heatpump_debug_set_topic    = "heatpump/debug/set";
+const heatpumpMqttLayout mqtt_layout = {
+  "heatpump",           // current settings
+  "heatpump/set",       // JSON commands, and heatpump/set/power "ON", heatpump/set/temperature "22.5", ...
+  "heatpump/status",
+  "heatpump/timers",
+  "heatpump/debug",
+  "heatpump/debug/set",
+  "heatpump/trace",     // base64 packet batches while debug mode is on
+  "heatpump/bridge",    // publish counters and free heap low-water mark
+  true,                 // per-field command topics
+  true,                 // retain the settings
+  false,                // Celsius
+  0                     // keep the remote temperature until told otherwise
+};
+const char* heatpump_metrics_topic      = "heatpump/metrics"; // protocol counters and state in the Prometheus text format
 
 // pinouts
 const int redLedPin  = 0; // Onboard LED = digital pin 0 (red LED on adafruit ESP8266 huzzah)
 const int blueLedPin = 2; // Onboard LED = digital pin 0 (blue LED on adafruit ESP8266 huzzah)
 
 // sketch settings
-const unsigned int SEND_ROOM_TEMP_INTERVAL_MS = 60000;
+const unsigned int SEND_ROOM_TEMP_INTERVAL_MS = 60000; // also publishes the metrics
+const unsigned long TRACE_BYTES_PER_SECOND = 256; // cap for the trace topic, 0 for none
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Host tests of the HeatPump library.
+#
+# Builds each extras/tests/*.cpp with the library sources and the stand-in for the Arduino core from
+# extras/replay/host, runs it, and exits non-zero if any test fails. Needs a C++11 compiler on Linux
+# (CXX, default g++); delegate_alloc counts allocations through glibc.
+#
+#   extras/host_tests.sh [test ...]     (default: all, e.g. extras/host_tests.sh proxy)
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BIN=${TMPDIR:-/tmp}/heatpump_host_test
+
+if [ $# -eq 0 ]; then
+  set -- $(cd "$ROOT/extras/tests" && ls *.cpp | sed 's/\.cpp$//')
+fi
+
+FAILED=0
+for TEST in "$@"; do
+  if ! ${CXX:-g++} -std=gnu++11 -O1 -g -Wall -Wextra -DARDUINO=100 -I"$ROOT/extras/replay/host" -I"$ROOT/src" \
+      "$ROOT/src/HeatPump.cpp" "$ROOT/src/HeatPumpHistory.cpp" "$ROOT/extras/tests/$TEST.cpp" -o "$BIN"; then
+    echo "$TEST: build failed"
+    FAILED=1
+  elif ! "$BIN"; then
+    FAILED=1
+  fi
+done
+exit $FAILED
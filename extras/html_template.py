@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Turns a web example's HTML template into a header, so the sketch never builds the page in a String.
+#
+# The template is split at its _PLACEHOLDER_ names into text segments kept in flash, each followed by the
+# slot the sketch fills in while streaming the page out. Static files given as name=path are gzipped into
+# byte arrays, to be served with Content-Encoding: gzip. Run it again after editing the template:
+#
+#   extras/html_template.py template.html [name=static.css ...] > sketch.h
+
+import gzip
+import os
+import re
+import sys
+
+PLACEHOLDER = re.compile(r'_([A-Z]+(?:_[A-Z0-9]+)?)_')
+
+
+def literal(text):
+    """C string literal, one source line per template line."""
+    if not text:
+        return '""'
+    lines = text.splitlines(True)
+    out = []
+    for line in lines:
+        escaped = line.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+        out.append('"' + escaped + '"')
+    return '\n  '.join(out)
+
+
+def split(template):
+    segments = []
+    pos = 0
+    for match in PLACEHOLDER.finditer(template):
+        segments.append((template[pos:match.start()], match.group(1)))
+        pos = match.end()
+    segments.append((template[pos:], 'END'))
+    return segments
+
+
+def main(args):
+    if not args:
+        sys.stderr.write('usage: html_template.py template.html [name=static.css ...]\n')
+        return 1
+
+    template_path = args[0]
+    with open(template_path) as f:
+        segments = split(f.read())
+
+    slots = []
+    for _, slot in segments:
+        if slot != 'END' and slot not in slots:
+            slots.append(slot)
+
+    sources = ' and '.join([os.path.basename(template_path)] +
+                           [os.path.basename(arg.split('=', 1)[1]) for arg in args[1:]])
+    print('// Generated by extras/html_template.py from %s, do not edit' % sources)
+    print('')
+    print('// placeholders, in order of first use')
+    print('enum htmlSlot : byte {')
+    for slot in slots:
+        print('  HTML_%s,' % slot)
+    print('  HTML_END')
+    print('};')
+    print('')
+    print('struct htmlSegment {')
+    print('  const char* text; // in flash')
+    print('  htmlSlot slot;    // filled in after text')
+    print('};')
+    print('')
+
+    for idx, (text, _) in enumerate(segments):
+        print('static const char html_%d[] PROGMEM =\n  %s;' % (idx, literal(text)))
+    print('')
+    print('static const htmlSegment html_segments[] = {')
+    for idx, (_, slot) in enumerate(segments):
+        print('  {html_%d, HTML_%s},' % (idx, slot))
+    print('};')
+
+    for arg in args[1:]:
+        name, path = arg.split('=', 1)
+        with open(path, 'rb') as f:
+            data = gzip.compress(f.read(), 9, mtime=0)
+        print('')
+        print('static const unsigned char %s_gz[] PROGMEM = {' % name)
+        for row in range(0, len(data), 16):
+            print('  ' + ', '.join('0x%02x' % b for b in data[row:row + 16]) + ',')
+        print('};')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Replays recorded heat pump traffic through the HeatPump library on this machine.
+#
+# Builds extras/replay/replay.cpp with the library sources and a small stand-in for the Arduino core,
+# then feeds it the captures. Prints every packet, settings and status change and (dis)connect, one per
+# line, and the packet count and decode throughput on stderr. Keep the output of a capture next to it
+# and compare later runs with diff to check that a change in the library decodes it the same way.
+# Needs a C++11 compiler (CXX, default g++).
+#
+#   extras/replay.sh [-x|-b|-t] [-q] [-n passes] [-r bitrate] [capture ...]
+#
+#   -x  hex text, the default: packet debug output as published by the examples ("packetSent":"FC 42 ...")
+#       or any lines of hex bytes
+#   -b  raw bytes as captured from the bus
+#   -t  batches from the trace topic (HeatPumpPacketTrace), one base64 batch per line, with the recorded
+#       timing, e.g. saved with mosquitto_sub -v -t heatpump/debug/trace
+#   -q  only the summary, for measuring throughput
+#   -n  replay the capture this many times
+#   -r  bitrate the capture was taken at, for the timing of -x and -b captures (default 2400)
+#
+# Without captures it reads stdin.
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BIN=${TMPDIR:-/tmp}/heatpump_replay
+
+${CXX:-g++} -std=gnu++11 -O2 -DARDUINO=100 -I"$ROOT/extras/replay/host" -I"$ROOT/src" \
+  "$ROOT/src/HeatPump.cpp" "$ROOT/src/HeatPumpHistory.cpp" "$ROOT/extras/replay/replay.cpp" -o "$BIN" || exit 1
+exec "$BIN" "$@"
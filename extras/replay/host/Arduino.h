@@ -0,0 +1,32 @@
+/*
+  Arduino.h - The parts of the Arduino core the HeatPump library uses, for building it on a PC
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __Arduino_H__
+#define __Arduino_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+
+#define SERIAL_8E1 0x26
+
+// the clock only moves when the host program moves it, so a replay runs at full speed
+unsigned long millis();
+void delay(unsigned long ms);
+
+#endif
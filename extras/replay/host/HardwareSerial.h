@@ -0,0 +1,29 @@
+/*
+  HardwareSerial.h - A serial port the host program fills and drains, for building the HeatPump library on a PC
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __HardwareSerial_H__
+#define __HardwareSerial_H__
+#include "Arduino.h"
+
+class HardwareSerial {
+  public:
+    virtual ~HardwareSerial() {}
+    virtual void begin(unsigned long /* baud */, int /* config */) {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t write(uint8_t b) = 0;
+};
+
+#endif
@@ -0,0 +1,317 @@
+/*
+  replay.cpp - Replays recorded heat pump traffic through the HeatPump library on a PC
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * The capture is fed to a HeatPump in listen mode, which takes requests and responses from one port
+ * and decodes them with the same code as a live connection. Every callback is printed as one line on
+ * stdout, with the time since the start of the capture, so the output of two library versions or two
+ * runs can be compared with diff. The summary and throughput go to stderr.
+ *
+ * Built and run by extras/replay.sh, see there for the options.
+ */
+#include <HeatPump.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+static unsigned long now = 0;
+
+unsigned long millis() {
+  return now;
+}
+
+void delay(unsigned long ms) {
+  now += ms;
+}
+
+// bytes that went over the bus together, and when
+struct chunk {
+  unsigned long time;
+  std::vector<byte> bytes;
+};
+
+class ReplaySerial : public HardwareSerial {
+  public:
+    std::deque<byte> rx;
+    unsigned long written = 0; // the library should never send anything during a replay
+
+    int available() override { return rx.size(); }
+    int read() override {
+      if (rx.empty()) {
+        return -1;
+      }
+      byte b = rx.front();
+      rx.pop_front();
+      return b;
+    }
+    size_t write(uint8_t /* b */) override {
+      written++;
+      return 1;
+    }
+};
+
+static const char FORMAT_HEX    = 'x';
+static const char FORMAT_BINARY = 'b';
+static const char FORMAT_TRACE  = 't';
+
+static const byte TRACE_VERSION = 1;
+static const byte TRACE_DIRECTION_CUSTOM = 2; // HeatPumpPacketTrace::DIRECTION_CUSTOM
+
+static unsigned long bitrate = 2400;
+
+// 8E1 is 11 bits on the wire per byte
+static unsigned long wireTime(size_t bytes) {
+  return bytes * 11 * 1000 / bitrate;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// the hex bytes of one debug line, e.g. {"packetRecv":"FC 62 01 30 10 02 ..."} or "fc620130..."
+// words with anything but hex digits in them (packetRecv, topics) are skipped
+static std::vector<byte> parseHexLine(const std::string& line) {
+  std::vector<byte> bytes;
+  size_t i = 0;
+  while (i < line.size()) {
+    if (!isalnum((unsigned char)line[i])) {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    bool hex = true;
+    while (i < line.size() && isalnum((unsigned char)line[i])) {
+      hex = hex && hexValue(line[i]) >= 0;
+      i++;
+    }
+    if (hex && (i - start) % 2 == 0) {
+      for (size_t j = start; j < i; j += 2) {
+        bytes.push_back(hexValue(line[j]) << 4 | hexValue(line[j + 1]));
+      }
+    }
+  }
+  return bytes;
+}
+
+static std::vector<byte> decodeBase64(const std::string& text) {
+  static const char* ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::vector<byte> bytes;
+  unsigned long bits = 0;
+  int count = 0;
+  for (char c : text) {
+    const char* p = c ? strchr(ALPHABET, c) : nullptr;
+    if (!p) {
+      continue; // padding, line ends
+    }
+    bits = bits << 6 | (p - ALPHABET);
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      bytes.push_back((bits >> count) & 0xff);
+    }
+  }
+  return bytes;
+}
+
+// one batch from HeatPumpPacketTrace: version, dropped packets, start time, then the packets with their offsets
+static bool parseTraceBatch(const std::vector<byte>& batch, std::vector<chunk>& chunks, unsigned long& dropped) {
+  if (batch.size() < 7 || batch[0] != TRACE_VERSION) {
+    return false;
+  }
+  dropped += batch[1] | batch[2] << 8;
+  unsigned long start = batch[3] | batch[4] << 8 | (unsigned long)batch[5] << 16 | (unsigned long)batch[6] << 24;
+  size_t i = 7;
+  while (i + 4 <= batch.size()) {
+    unsigned long offset = batch[i] | batch[i + 1] << 8;
+    byte direction = batch[i + 2];
+    size_t length = batch[i + 3];
+    i += 4;
+    if (i + length > batch.size()) {
+      return false;
+    }
+    // a custom packet is traced once more as sent when it goes out
+    if (direction != TRACE_DIRECTION_CUSTOM) {
+      chunks.push_back({start + offset, std::vector<byte>(batch.begin() + i, batch.begin() + i + length)});
+    }
+    i += length;
+  }
+  return true;
+}
+
+static void load(FILE* in, char format, std::vector<chunk>& chunks, unsigned long& dropped) {
+  unsigned long time = 0;
+  if (format == FORMAT_BINARY) {
+    byte buffer[16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+      chunks.push_back({time, std::vector<byte>(buffer, buffer + n)});
+      time += wireTime(n);
+    }
+    return;
+  }
+
+  std::string line;
+  int c;
+  do {
+    c = fgetc(in);
+    if (c != '\n' && c != EOF) {
+      line += (char)c;
+      continue;
+    }
+    if (format == FORMAT_TRACE) {
+      // the payload is the last word, so "topic payload" lines from mosquitto_sub -v work as well
+      size_t space = line.find_last_of(" \t");
+      std::string payload = space == std::string::npos ? line : line.substr(space + 1);
+      if (!payload.empty() && !parseTraceBatch(decodeBase64(payload), chunks, dropped)) {
+        fprintf(stderr, "skipped a line that is not a trace batch: %.40s\n", line.c_str());
+      }
+    } else {
+      std::vector<byte> bytes = parseHexLine(line);
+      if (!bytes.empty()) {
+        chunks.push_back({time, bytes});
+        time += wireTime(bytes.size());
+      }
+    }
+    line.clear();
+  } while (c != EOF);
+}
+
+// the callbacks only capture what fits a heatpumpDelegate, so the replay state is kept here
+static HeatPump hp;
+static bool quiet = false;
+static unsigned long start = 0;
+static unsigned long packets = 0;
+
+static const char* text(const char* s) {
+  return s ? s : "-";
+}
+
+int main(int argc, char* argv[]) {
+  char format = FORMAT_HEX;
+  int passes = 1;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1]; arg++) {
+    switch (argv[arg][1]) {
+      case 'b': format = FORMAT_BINARY; break;
+      case 't': format = FORMAT_TRACE; break;
+      case 'x': format = FORMAT_HEX; break;
+      case 'q': quiet = true; break;
+      case 'n': passes = arg + 1 < argc ? atoi(argv[++arg]) : 1; break;
+      case 'r': bitrate = arg + 1 < argc ? atol(argv[++arg]) : 2400; break;
+      default:
+        fprintf(stderr, "usage: replay [-x|-b|-t] [-q] [-n passes] [-r bitrate] [capture ...]\n");
+        return 2;
+    }
+  }
+
+  std::vector<chunk> chunks;
+  unsigned long dropped = 0;
+  if (arg == argc) {
+    load(stdin, format, chunks, dropped);
+  }
+  for (; arg < argc; arg++) {
+    FILE* in = fopen(argv[arg], format == FORMAT_BINARY ? "rb" : "r");
+    if (!in) {
+      perror(argv[arg]);
+      return 1;
+    }
+    load(in, format, chunks, dropped);
+    fclose(in);
+  }
+  if (chunks.empty()) {
+    fprintf(stderr, "no packets in the capture\n");
+    return 1;
+  }
+
+  ReplaySerial serial;
+  start = chunks[0].time;
+  unsigned long bytes = 0;
+
+  hp.setPacketCallback([](byte* packet, unsigned int length, char* packetDirection) {
+    packets++;
+    if (quiet) {
+      return;
+    }
+    printf("%lu %s", now - start, packetDirection[6] == 'S' ? "request " : "response");
+    for (unsigned int i = 0; i < length; i++) {
+      printf(" %02x", packet[i]);
+    }
+    printf("\n");
+  });
+  hp.setSettingsChangedCallback([]() {
+    if (quiet) {
+      return;
+    }
+    heatpumpSettings s = hp.getSettings();
+    printf("%lu settings power=%s mode=%s temperature=%.1f fan=%s vane=%s wideVane=%s iSee=%d\n", now - start,
+           text(s.power), text(s.mode), s.temperature, text(s.fan), text(s.vane), text(s.wideVane), s.iSee);
+  });
+  hp.setStatusChangedCallback([](heatpumpStatus s) {
+    if (quiet) {
+      return;
+    }
+    printf("%lu status roomTemperature=%.1f operating=%d compressorFrequency=%d timers=%s/%d/%d/%d/%d\n",
+           now - start, s.roomTemperature, s.operating, s.compressorFrequency, text(s.timers.mode),
+           s.timers.onMinutesSet, s.timers.onMinutesRemaining, s.timers.offMinutesSet, s.timers.offMinutesRemaining);
+  });
+
+  now = start;
+  hp.connectListener(&serial, 0);
+  bool connected = false;
+  std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < passes; pass++) {
+    unsigned long passStart = now - start;
+    for (const chunk& c : chunks) {
+      // the clock only ever moves forward, captures can span a reboot of the board that recorded them
+      unsigned long t = passStart + (c.time - chunks[0].time) + start;
+      if ((long)(t - now) > 0) {
+        now = t;
+      }
+      serial.rx.insert(serial.rx.end(), c.bytes.begin(), c.bytes.end());
+      bytes += c.bytes.size();
+      hp.sync();
+      if (hp.isConnected() != connected) {
+        connected = hp.isConnected();
+        if (!quiet) {
+          printf("%lu %s\n", now - start, connected ? "connected" : "disconnected");
+        }
+      }
+    }
+  }
+  fflush(stdout);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+
+  heatpumpLinkStats stats = hp.getLinkStats();
+  fprintf(stderr, "%lu packets, %lu bytes, %lu checksum and %lu header errors", packets, bytes,
+          stats.checksumErrors, stats.headerErrors);
+  if (dropped) {
+    fprintf(stderr, ", %lu dropped by the trace", dropped);
+  }
+  fprintf(stderr, "\n%.3f s, %.0f packets/s, %.0f bytes/s\n", seconds, packets / seconds, bytes / seconds);
+  if (serial.written) {
+    fprintf(stderr, "the library sent %lu bytes, replays must not send\n", serial.written);
+    return 1;
+  }
+  return 0;
+}
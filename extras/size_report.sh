@@ -0,0 +1,40 @@
+#!/bin/sh
+# Per-feature flash and RAM cost of the HeatPump library.
+#
+# Compiles examples/heatPump_test with every feature from src/HeatPumpConfig.h enabled, then once
+# more with each feature disabled, and prints how much flash and RAM each one saves.
+# Needs arduino-cli with the core for the board installed.
+#
+#   extras/size_report.sh [fqbn]     (default esp8266:esp8266:generic)
+
+FQBN=${1:-esp8266:esp8266:generic}
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+SKETCH="$ROOT/examples/heatPump_test"
+FEATURES="FUNCTIONS TIMERS CUSTOM_PACKETS FAHRENHEIT PACKET_CALLBACK ROOM_TEMP_CALLBACK RESPONSE_HANDLERS SNAPSHOTS CHANGE_LOG HISTORY RUNTIME_STATS LINK_STATS WARM_START IDLE_MODE PROXY"
+
+# prints "<flash> <ram>" in bytes
+measure() {
+  arduino-cli compile --fqbn "$FQBN" --library "$ROOT" --clean \
+    --build-property "compiler.cpp.extra_flags=$1" "$SKETCH" 2>&1 |
+    sed -n -e 's/^Sketch uses \([0-9]*\) bytes.*/\1/p' -e 's/^Global variables use \([0-9]*\) bytes.*/\1/p' |
+    tr '\n' ' '
+}
+
+set -- $(measure "")
+if [ -z "$2" ]; then
+  echo "compile failed, is the core for $FQBN installed?" >&2
+  exit 1
+fi
+BASE_FLASH=$1
+BASE_RAM=$2
+
+echo "board $FQBN, all features: flash $BASE_FLASH, ram $BASE_RAM"
+printf "%-20s %10s %10s\n" feature flash ram
+for FEATURE in $FEATURES; do
+  set -- $(measure "-DHEATPUMP_ENABLE_$FEATURE=0")
+  if [ -z "$2" ]; then
+    printf "%-20s %21s\n" "$FEATURE" "compile failed"
+    continue
+  fi
+  printf "%-20s %10d %10d\n" "$FEATURE" $((BASE_FLASH - $1)) $((BASE_RAM - $2))
+done
@@ -0,0 +1,148 @@
+/*
+  delegate_alloc.cpp - Host test: callbacks never allocate
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Every allocation through new or malloc is counted (malloc through the glibc entry points). Callbacks
+ * whose captures take all of HEATPUMP_DELEGATE_SIZE are registered, copied, replaced and called while
+ * the heat pump connects and syncs, and the count has to stay at zero.
+ */
+#include "host_test.h"
+#include "fake_unit.h"
+#include <new>
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void __libc_free(void* pointer);
+
+extern "C" void* malloc(size_t size) {
+  allocations += counting;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  allocations += counting;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+  allocations += counting;
+  return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) {
+  __libc_free(pointer);
+}
+
+void* operator new(size_t size) {
+  allocations += counting;
+  void* pointer = __libc_malloc(size ? size : 1);
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+  __libc_free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  __libc_free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  __libc_free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+  __libc_free(pointer);
+}
+
+// as big as a capture may be
+struct fullCapture {
+  unsigned long* counter;
+  char padding[HEATPUMP_DELEGATE_SIZE - sizeof(unsigned long*)];
+};
+
+static unsigned long connects = 0;
+static unsigned long settingsChanges = 0;
+static unsigned long statusChanges = 0;
+static unsigned long packets = 0;
+
+int main() {
+  static FakeUnit unit;
+  static HeatPump hp;
+  fullCapture onConnect = {&connects, {}};
+  fullCapture onSettings = {&settingsChanges, {}};
+  fullCapture onStatus = {&statusChanges, {}};
+  fullCapture onPacket = {&packets, {}};
+
+  counting = true;
+
+  hp.setOnConnectCallback([onConnect]() { (*onConnect.counter)++; });
+  hp.setSettingsChangedCallback([onSettings]() { (*onSettings.counter)++; });
+  hp.setStatusChangedCallback([onStatus](heatpumpStatus) { (*onStatus.counter)++; });
+  hp.setPacketCallback([onPacket](byte*, unsigned int, char*) { (*onPacket.counter)++; });
+
+  // copies, assignments and replacing a callback with another
+  heatpumpDelegate<void()> first([onConnect]() { (*onConnect.counter)++; });
+  heatpumpDelegate<void()> second(first);
+  heatpumpDelegate<void()> third;
+  third = second;
+  third = [onSettings]() { (*onSettings.counter)++; };
+  first();
+  second();
+  third();
+  CHECK(connects == 2);
+  CHECK(settingsChanges == 1);
+
+  // clearing with NULL, as sketches did with plain function pointers, and with nullptr
+  heatpumpDelegate<void()> cleared(NULL);
+  CHECK(!cleared);
+  third = NULL;
+  CHECK(!third);
+  second = nullptr;
+  CHECK(!second);
+  hp.setOnConnectCallback(NULL);
+  hp.setOnConnectCallback([onConnect]() { (*onConnect.counter)++; });
+
+  hp.connect(&unit);
+  for (int i = 0; i < 40; i++) {
+    hp.sync();
+    delay(300);
+  }
+
+  counting = false;
+
+  CHECK(hp.isConnected());
+  CHECK(connects == 3);
+  CHECK(settingsChanges >= 2);
+  CHECK(statusChanges >= 1);
+  CHECK(packets > 10);
+  CHECK(allocations == 0);
+  if (allocations) {
+    printf("%lu allocations\n", allocations);
+  }
+  return hostResult("delegate_alloc");
+}
@@ -0,0 +1,163 @@
+/*
+  fake_unit.h - Simulated indoor unit and wall controller for the host tests of the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __fake_unit_H__
+#define __fake_unit_H__
+#include <HardwareSerial.h>
+
+/*
+ * Fixed buffers only, so that delegate_alloc can count every allocation the library makes.
+ */
+
+// one packet, up to 16 data bytes
+struct hostPacket {
+  byte data[22];
+  int length;
+
+  byte operator[](int i) const { return data[i]; }
+};
+
+// a packet from its bytes without the checksum, which is added
+inline hostPacket makePacket(const byte* bytes, int length) {
+  hostPacket packet = {{}, length + 1};
+  int sum = 0;
+  for (int i = 0; i < length; i++) {
+    packet.data[i] = bytes[i];
+    sum += bytes[i];
+  }
+  packet.data[length] = (0xfc - sum) & 0xff;
+  return packet;
+}
+
+// an info request for one response type, as a controller sends it
+inline hostPacket infoRequest(byte type) {
+  byte bytes[21] = {0xfc, 0x42, 0x01, 0x30, 0x10, type};
+  return makePacket(bytes, sizeof(bytes));
+}
+
+// what the other end of a serial line has sent and is still to be read, and everything it received
+class HostSerial : public HardwareSerial {
+  private:
+    static const int RX_LEN = 256;
+    byte rx[RX_LEN];
+    int rxHead = 0;
+    int rxCount = 0;
+
+  public:
+    static const int RECEIVED_LEN = 4096;
+    byte received[RECEIVED_LEN];
+    int receivedCount = 0;
+
+    int available() override { return rxCount; }
+    int read() override {
+      if (rxCount == 0) {
+        return -1;
+      }
+      byte b = rx[rxHead];
+      rxHead = (rxHead + 1) % RX_LEN;
+      rxCount--;
+      return b;
+    }
+    size_t write(uint8_t b) override {
+      if (receivedCount < RECEIVED_LEN) {
+        received[receivedCount++] = b;
+      }
+      return 1;
+    }
+    void send(const byte* bytes, int length) {
+      for (int i = 0; i < length && rxCount < RX_LEN; i++) {
+        rx[(rxHead + rxCount++) % RX_LEN] = bytes[i];
+      }
+    }
+    void send(const hostPacket& packet) {
+      send(packet.data, packet.length);
+    }
+    // takes what is waiting to be read, e.g. to deliver it later
+    int take(byte* bytes, int length) {
+      int n = 0;
+      while (n < length && rxCount > 0) {
+        bytes[n++] = read();
+      }
+      return n;
+    }
+};
+
+/*
+ * Answers every complete packet it receives at once: connect, settings updates, and info requests for
+ * settings, room temperature and status. The answer is ready to read on the next available().
+ */
+class FakeUnit : public HostSerial {
+  private:
+    hostPacket packet = {{}, 0};
+
+    void reply(byte type, const byte* data, int length) {
+      byte bytes[21] = {0xfc, type, 0x01, 0x30, (byte)length};
+      memcpy(bytes + 5, data, length);
+      send(makePacket(bytes, 5 + length));
+    }
+
+    void handle() {
+      if (packetCount < PACKETS_LEN) {
+        packets[packetCount++] = packet;
+      }
+      byte data[16] = {};
+      if (packet[1] == 0x5a) {
+        reply(0x7a, data, 1);
+      } else if (packet[1] == 0x41) {
+        if (packet[5] == 0x01) {
+          packet.data[6] &= ~ignored; // acknowledged all the same
+          if (packet[6] & 0x01) settings[3] = packet[8];
+          if (packet[6] & 0x02) settings[4] = packet[9];
+          if (packet[6] & 0x04) settings[5] = packet[10];
+          if (packet[6] & 0x08) settings[6] = packet[11];
+          if (packet[6] & 0x10) settings[7] = packet[12];
+          if (packet[7] & 0x01) settings[10] = packet[18];
+        }
+        reply(0x61, data, 16);
+      } else if (packet[1] == 0x42) {
+        data[0] = packet[5];
+        if (packet[5] == 0x02) memcpy(data, settings, 16);
+        if (packet[5] == 0x03) memcpy(data, roomTemp, 16);
+        if (packet[5] == 0x06) memcpy(data, status, 16);
+        reply(0x62, data, 16);
+      }
+    }
+
+  public:
+    static const int PACKETS_LEN = 128;
+
+    // power on, cool, 23 degrees, fan and vanes auto, room 20 degrees, compressor off
+    byte settings[16] = {0x02, 0, 0, 0x01, 0x03, 0x08, 0x00, 0x00, 0, 0, 0x03, 0, 0, 0, 0, 0};
+    byte roomTemp[16] = {0x03, 0, 0, 0x0b, 0, 0, 0xa8, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    byte status[16]   = {0x06, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    hostPacket packets[PACKETS_LEN]; // every packet received, in order
+    int packetCount = 0;
+    byte ignored = 0; // control flags of byte 6 whose values it does not support, like a model without vanes
+
+    size_t write(uint8_t b) override {
+      HostSerial::write(b);
+      if (packet.length == 0 && b != 0xfc) {
+        return 1;
+      }
+      packet.data[packet.length++] = b;
+      if (packet.length >= 5 && packet.length == packet.data[4] + 6) {
+        handle();
+        packet.length = 0;
+      }
+      return 1;
+    }
+};
+
+#endif
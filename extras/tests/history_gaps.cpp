@@ -0,0 +1,67 @@
+/*
+  history_gaps.cpp - Host test: history ages across gaps
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Feeds a HeatPumpHistory directly, with an hour without samples in between (the unit was disconnected),
+ * and checks that the points before the gap are aged by the time that really passed and that the minute
+ * interrupted by the gap is not rolled up.
+ */
+#include "host_test.h"
+#include <HeatPumpHistory.h>
+
+static void feed(HeatPumpHistory& history, unsigned long ms, float roomTemperature) {
+  heatpumpStatus status {};
+  status.roomTemperature = roomTemperature;
+  for (unsigned long t = 0; t < ms; t += 1000) {
+    history.record(status);
+    delay(1000);
+  }
+}
+
+int main() {
+  static HeatPumpHistory history;
+  const unsigned long SAMPLE = HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS;
+
+  feed(history, 90000, 20); // a minute and a half
+  CHECK(history.getCount(HeatPumpHistory::RESOLUTION_RAW) == 9);
+  CHECK(history.getCount(HeatPumpHistory::RESOLUTION_MINUTE) == 1);
+
+  delay(3600000UL);
+  feed(history, 60000, 22);
+  CHECK(history.getCount(HeatPumpHistory::RESOLUTION_RAW) == 15);
+  // the half minute before the gap is dropped, the minute after it is complete
+  CHECK(history.getCount(HeatPumpHistory::RESOLUTION_MINUTE) == 2);
+
+  heatpumpHistoryPoint newest = history.getPoint(HeatPumpHistory::RESOLUTION_RAW, 14);
+  heatpumpHistoryPoint afterGap = history.getPoint(HeatPumpHistory::RESOLUTION_RAW, 9);
+  heatpumpHistoryPoint beforeGap = history.getPoint(HeatPumpHistory::RESOLUTION_RAW, 8);
+  heatpumpHistoryPoint oldest = history.getPoint(HeatPumpHistory::RESOLUTION_RAW, 0);
+  CHECK(newest.ageMs <= SAMPLE);
+  CHECK(newest.roomTemperatureMean == 22);
+  CHECK(afterGap.ageMs == newest.ageMs + 5 * SAMPLE);
+  CHECK(beforeGap.roomTemperatureMean == 20);
+  // an hour and a sample apart, give or take the rounding to whole samples
+  CHECK(beforeGap.ageMs >= afterGap.ageMs + 3600000UL);
+  CHECK(beforeGap.ageMs <= afterGap.ageMs + 3600000UL + 2 * SAMPLE);
+  CHECK(oldest.ageMs == beforeGap.ageMs + 8 * SAMPLE);
+
+  heatpumpHistoryPoint minuteBefore = history.getPoint(HeatPumpHistory::RESOLUTION_MINUTE, 0);
+  heatpumpHistoryPoint minuteAfter = history.getPoint(HeatPumpHistory::RESOLUTION_MINUTE, 1);
+  CHECK(minuteBefore.roomTemperatureMax == 20);
+  CHECK(minuteAfter.roomTemperatureMin == 22);
+  CHECK(minuteBefore.ageMs >= minuteAfter.ageMs + 3600000UL);
+  return hostResult("history_gaps");
+}
@@ -0,0 +1,48 @@
+/*
+  host_test.h - Clock and checks for the host tests of the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __host_test_H__
+#define __host_test_H__
+#include <HeatPump.h>
+#include <stdio.h>
+
+// each test is a single translation unit, so the clock is defined here
+static unsigned long hostNow = 100000;
+
+unsigned long millis() {
+  return hostNow;
+}
+
+void delay(unsigned long ms) {
+  hostNow += ms;
+}
+
+static int hostFailures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+      hostFailures++; \
+    } \
+  } while (0)
+
+// exit code for main()
+static int hostResult(const char* name) {
+  printf("%s: %s\n", name, hostFailures ? "FAILED" : "ok");
+  return hostFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+  ignored_setting.cpp - Host test: a setting the unit acknowledges but does not apply
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * The unit has no vanes: it acknowledges a vane position and keeps reporting its own. With autoUpdate the
+ * wanted vane has to fall back to the unit's after a few polls, instead of being sent on every sync()
+ * forever, while a fan speed set in the same update() is applied as usual.
+ */
+#include "host_test.h"
+#include "fake_unit.h"
+#include <string.h>
+
+static int setPackets(const FakeUnit& unit) {
+  int count = 0;
+  for (int i = 0; i < unit.packetCount; i++) {
+    if (unit.packets[i][1] == 0x41 && unit.packets[i][5] == 0x01) {
+      count++;
+    }
+  }
+  return count;
+}
+
+int main() {
+  static FakeUnit unit;
+  static HeatPump hp;
+  unit.ignored = 0x10; // vane
+  hp.enableAutoUpdate();
+  hp.connect(&unit);
+  for (int i = 0; i < 10; i++) {
+    hp.sync();
+    delay(300);
+  }
+  CHECK(strcmp(hp.getVaneSetting(), "AUTO") == 0);
+
+  hp.setVaneSetting("SWING");
+  hp.setFanSpeed("3");
+  for (int i = 0; i < 40; i++) {
+    hp.sync();
+    delay(300);
+  }
+  int sent = setPackets(unit);
+  CHECK(sent >= 1);
+  CHECK(sent <= 3);
+  CHECK(strcmp(hp.getFanSpeed(), "3") == 0);
+  CHECK(strcmp(hp.getVaneSetting(), "AUTO") == 0);
+  CHECK(strcmp(hp.getWantedSettings().vane, "AUTO") == 0);
+
+  // nothing left to send
+  for (int i = 0; i < 40; i++) {
+    hp.sync();
+    delay(300);
+  }
+  CHECK(setPackets(unit) == sent);
+
+  // a value the unit does support still goes out afterwards
+  hp.setVaneSetting("3");
+  unit.ignored = 0;
+  for (int i = 0; i < 20; i++) {
+    hp.sync();
+    delay(300);
+  }
+  CHECK(strcmp(hp.getVaneSetting(), "3") == 0);
+  return hostResult("ignored_setting");
+}
@@ -0,0 +1,185 @@
+/*
+  proxy.cpp - Host test: proxy mode between a wall controller and the unit
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * The unit is a FakeUnit, the controller a HostSerial the test writes its requests into. Checks that
+ * requests and answers are forwarded unchanged, that an update() goes out in a pause with the
+ * controller's bytes held back meanwhile, that the controller's own settings changes are picked up,
+ * and that a full queue refuses commands at once, without a unit and on a bus the controller keeps busy.
+ */
+#include "host_test.h"
+#include "fake_unit.h"
+#include <string.h>
+
+static bool samePacket(const hostPacket& packet, const byte* bytes) {
+  return memcmp(packet.data, bytes, packet.length) == 0;
+}
+
+// lets the bus go quiet, so the library may send its own packets
+static void pause(HeatPump& hp) {
+  for (int i = 0; i < 10; i++) {
+    delay(10);
+    hp.sync();
+  }
+}
+
+static unsigned long functionsCalls = 0;
+static bool functionsValid = true;
+
+static void forwarding() {
+  static FakeUnit unit;
+  static HostSerial controller;
+  static HeatPump hp;
+  hp.connectProxy(&unit, &controller, 2400);
+  CHECK(!hp.isConnected());
+
+  // controller to unit, and the answer back
+  hostPacket request = infoRequest(0x02);
+  controller.send(request);
+  hp.sync();
+  CHECK(unit.packetCount == 1);
+  CHECK(samePacket(unit.packets[0], request.data));
+  hp.sync();
+  CHECK(hp.isConnected());
+  CHECK(controller.receivedCount == 22);
+  CHECK(controller.received[1] == 0x62 && controller.received[5] == 0x02);
+  CHECK(strcmp(hp.getPowerSetting(), "ON") == 0);
+  CHECK(hp.getTemperature() == 23);
+
+  // an update goes out in the next pause, the controller's request is held back until it is answered
+  hp.setTemperature(25);
+  CHECK(hp.update());
+  CHECK(unit.packetCount == 1);
+  delay(10);
+  hp.sync();
+  CHECK(unit.packetCount == 1); // the bus has not been quiet for long enough
+  for (int i = 0; i < 10 && unit.packetCount == 1; i++) {
+    delay(10);
+    hp.sync();
+  }
+  CHECK(unit.packetCount == 2);
+  CHECK(unit.packets[1][1] == 0x41 && unit.packets[1][5] == 0x01);
+
+  int forwarded = controller.receivedCount;
+  hostPacket held = infoRequest(0x03);
+  controller.send(held);
+  hp.sync();
+  // the 0x61 was ours and stays here, the held request went to the unit right after it and its answer is passed on
+  CHECK(unit.packetCount == 3);
+  CHECK(samePacket(unit.packets[2], held.data));
+  CHECK(controller.receivedCount == forwarded + 22);
+  CHECK(controller.received[forwarded + 1] == 0x62 && controller.received[forwarded + 5] == 0x03);
+
+  // the new settings are read back by ourselves, that answer is not passed on either
+  pause(hp);
+  CHECK(unit.packetCount == 4);
+  CHECK(unit.packets[3][1] == 0x42 && unit.packets[3][5] == 0x02);
+  CHECK(controller.receivedCount == forwarded + 22);
+  CHECK(hp.getTemperature() == 25);
+
+  // a change made on the controller shows as soon as the unit acknowledges it, without a poll
+  byte set[21] = {0xfc, 0x41, 0x01, 0x30, 0x10, 0x01, 0x05, 0x00, 0x00, 0x00, 0x0b}; // power off, 20 degrees
+  controller.send(makePacket(set, sizeof(set)));
+  hp.sync();
+  CHECK(unit.packetCount == 5);
+  CHECK(controller.received[controller.receivedCount - 22 + 1] == 0x61);
+  CHECK(strcmp(hp.getPowerSetting(), "OFF") == 0);
+  CHECK(hp.getTemperature() == 20);
+  pause(hp);
+  CHECK(unit.packetCount == 5);
+
+  // the installer functions need a bus of our own
+  int sent = unit.packetCount;
+  CHECK(!hp.getFunctions().isValid());
+  hp.setFunctionsCallback([](heatpumpFunctions functions) {
+    functionsCalls++;
+    functionsValid = functions.isValid();
+  });
+  hp.requestFunctions();
+  pause(hp);
+  CHECK(functionsCalls == 1);
+  CHECK(!functionsValid);
+  CHECK(unit.packetCount == sent);
+}
+
+static void noUnit() {
+  static HostSerial unit;
+  static HostSerial controller;
+  static HeatPump hp;
+  hp.connectProxy(&unit, &controller, 2400);
+
+  // nothing answers, the queue fills up and further commands are refused instead of dropped
+  byte custom[] = {0x42, 0x01, 0x30, 0x10, 0x05};
+  int queued = 0;
+  while (queued < 10 && hp.sendCustomPacket(custom, sizeof(custom))) {
+    queued++;
+  }
+  CHECK(queued == 4);
+  CHECK(!hp.setRemoteTemperature(21));
+  hp.setTemperature(25);
+  CHECK(!hp.update());
+  pause(hp);
+  CHECK(unit.receivedCount == 0);
+}
+
+static unsigned long packets = 0;
+
+static void busyBus() {
+  static FakeUnit unit;
+  static HostSerial controller;
+  static HeatPump hp;
+  hp.connectProxy(&unit, &controller, 2400);
+  hp.setPacketCallback([](byte*, unsigned int, char*) { packets++; });
+  controller.send(infoRequest(0x02));
+  hp.sync();
+  hp.sync();
+  CHECK(hp.isConnected());
+
+  // the controller never leaves a pause, a full queue refuses at once instead of waiting for the bus
+  hostPacket timers = infoRequest(0x05);
+  byte* custom = timers.data + 1; // without the start byte and the checksum
+  int queued = 0;
+  bool refused = false;
+  for (int i = 0; i < 20; i++) {
+    controller.send(infoRequest(0x03));
+    hp.sync();
+    delay(20);
+    unsigned long before = packets;
+    if (hp.sendCustomPacket(custom, timers.length - 2)) {
+      queued++;
+    } else {
+      refused = true;
+      CHECK(packets == before); // nothing was forwarded or decoded from inside the call
+    }
+  }
+  CHECK(queued == 4);
+  CHECK(refused);
+  CHECK(!hp.update());
+  int sent = unit.packetCount;
+
+  // once the controller pauses, the queued packets go out
+  for (int i = 0; i < 4; i++) {
+    pause(hp);
+  }
+  CHECK(unit.packetCount == sent + 4);
+}
+
+int main() {
+  forwarding();
+  noUnit();
+  busyBus();
+  return hostResult("proxy");
+}
@@ -17,13 +17,20 @@ const char* mqtt_password = "<YOUR MQTT PASSWORD GOES HERE>";
 
 // mqtt client settings
 const char* client_id                   = "heatpump-controller-2"; // Must be unique on the MQTT network
-const char* heatpump_topic              = "home/heatpump";  //contains current settings
-const char* heatpump_set_topic          = "home/heatpump/set"; //listens for commands
-const char* heatpump_status_topic       = "home/heatpump/status"; //sends room temp and operation status
-const char* heatpump_timers_topic       = "home/heatpump/timers"; //timers
-
-const char* heatpump_debug_topic        = "home/heatpump/debug"; //debug messages
-const char* heatpump_debug_set_topic    = "home/heatpump/debug/set"; //enable/disable debug messages
+const heatpumpMqttLayout mqtt_layout = {
+  "home/heatpump",           //contains current settings
+  "home/heatpump/set",       //listens for commands
+  "home/heatpump/status",    //sends room temp and operation status
+  "home/heatpump/timers",    //timers
+  "home/heatpump/debug",     //debug messages
+  "home/heatpump/debug/set", //enable/disable debug messages
+  "home/heatpump/trace",     //packets while debug is enabled
+  nullptr,                   //no bridge counters
+  false,                     //JSON commands only
+  true,                      //change to false to disable mqtt retain
+  false,                     //false = Celsius, true = Fahrenheit
+  300000                     //reset to local temp sensor after 5 minutes of no remote temp updates
+};
 
 // pinouts
 const int redLedPin  = 0; // Onboard LED = digital pin 0 (red LED on adafruit ESP8266 huzzah)
@@ -31,4 +38,3 @@ const int blueLedPin = 2; // Onboard LED = digital pin 0 (blue LED on adafruit E
 
 // sketch settings
 const unsigned int SEND_ROOM_TEMP_INTERVAL_MS = 60000;
-const bool isCelsius = true;   // true = Celsius, false = Fahreneit
@@ -17,6 +17,9 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "HeatPump.h"
+#if HEATPUMP_ENABLE_HISTORY
+#include "HeatPumpHistory.h"
+#endif
 
 // Structures //////////////////////////////////////////////////////////////////
 
@@ -66,6 +69,54 @@ bool operator!=(const heatpumpTimers& lhs, const heatpumpTimers& rhs) {
          lhs.offMinutesRemaining != rhs.offMinutesRemaining;
 }
 
+bool operator==(const heatpumpStatus& lhs, const heatpumpStatus& rhs) {
+  return lhs.roomTemperature     == rhs.roomTemperature &&
+         lhs.operating           == rhs.operating &&
+         lhs.timers              == rhs.timers &&
+         lhs.compressorFrequency == rhs.compressorFrequency;
+}
+
+bool operator!=(const heatpumpStatus& lhs, const heatpumpStatus& rhs) {
+  return !(lhs == rhs);
+}
+
+
+// Wire schema /////////////////////////////////////////////////////////////////
+
+constexpr byte HeatPump::CONNECT[];
+constexpr byte HeatPump::HEADER[];
+constexpr byte HeatPump::INFOHEADER[];
+constexpr byte HeatPump::INFOMODE[];
+
+const int HeatPump::INFOHEADER_SUM = sumBytes(INFOHEADER, INFOHEADER_LEN);
+
+const HeatPump::wireValue HeatPump::POWER_VALUES[2] = {
+  {0x00, "OFF"}, {0x01, "ON"}
+};
+const HeatPump::wireValue HeatPump::MODE_VALUES[5] = {
+  {0x01, "HEAT"}, {0x02, "DRY"}, {0x03, "COOL"}, {0x07, "FAN"}, {0x08, "AUTO"}
+};
+const HeatPump::wireValue HeatPump::FAN_VALUES[6] = {
+  {0x00, "AUTO"}, {0x01, "QUIET"}, {0x02, "1"}, {0x03, "2"}, {0x05, "3"}, {0x06, "4"}
+};
+const HeatPump::wireValue HeatPump::VANE_VALUES[7] = {
+  {0x00, "AUTO"}, {0x01, "1"}, {0x02, "2"}, {0x03, "3"}, {0x04, "4"}, {0x05, "5"}, {0x07, "SWING"}
+};
+const HeatPump::wireValue HeatPump::WIDEVANE_VALUES[7] = {
+  {0x01, "<<"}, {0x02, "<"}, {0x03, "|"}, {0x04, ">"}, {0x05, ">>"}, {0x08, "<>"}, {0x0c, "SWING"}
+};
+const HeatPump::wireValue HeatPump::TIMER_MODE_VALUES[4] = {
+  {0x00, "NONE"}, {0x01, "OFF"}, {0x02, "ON"}, {0x03, "BOTH"}
+};
+
+const HeatPump::wireField HeatPump::SETTING_FIELDS[SETTING_FIELD_COUNT] = {
+  // setting                     set  ctrl flag  get  mask  values
+  {&heatpumpSettings::power,     8,   6,   0x01, 3,   0xff, POWER_VALUES,    2},
+  {&heatpumpSettings::mode,      9,   6,   0x02, 4,   0xff, MODE_VALUES,     5},
+  {&heatpumpSettings::fan,       11,  6,   0x08, 6,   0xff, FAN_VALUES,      6},
+  {&heatpumpSettings::vane,      12,  6,   0x10, 7,   0xff, VANE_VALUES,     7},
+  {&heatpumpSettings::wideVane,  18,  7,   0x01, 10,  0x0f, WIDEVANE_VALUES, 7}
+};
 
 // Constructor /////////////////////////////////////////////////////////////////
 
@@ -82,7 +133,6 @@ HeatPump::HeatPump() {
   waitForRead = false;
   externalUpdate = false;
   wideVaneAdj = false;
-  functions = heatpumpFunctions();
 }
 
 // Public Methods //////////////////////////////////////////////////////////////
@@ -105,7 +155,8 @@ bool HeatPump::connect(HardwareSerial *serial, int bitrate, int rx, int tx) {
   }
   bool retry = false;
   if(bitrate == 0) {
-    bitrate = 2400;
+    // start with the rate that worked last time, and retry with the other one
+    bitrate = linkBitrate ? linkBitrate : 2400;
     retry = true;
   }
   if (rx >= 0 && tx >= 0) {
@@ -144,33 +195,99 @@ bool HeatPump::connect(HardwareSerial *serial, int bitrate, int rx, int tx) {
   // send the CONNECT packet twice - need to copy the CONNECT packet locally
   byte packet[CONNECT_LEN];
   memcpy(packet, CONNECT, CONNECT_LEN);
+#if HEATPUMP_ENABLE_LINK_STATS
+  linkStats.connects++;
+#endif
   //for(int count = 0; count < 2; count++) {
   writePacket(packet, CONNECT_LEN);
   while(!canRead()) { delay(10); }
   int packetType = readPacket();
   if (packetType != RCVD_PKT_CONNECT_SUCCESS && retry)
   {
+    int otherBitrate = bitrate == 2400 ? 9600 : 2400;
     if (rxPin > 0 && rxPin > 0) // check if custom pin previous set
     {
-      return connect(serial, 9600, rxPin, txPin);
+      return connect(serial, otherBitrate, rxPin, txPin);
     }
     else
     {
-      return connect(serial, 9600, rx, tx);
+      return connect(serial, otherBitrate, rx, tx);
     }
   }
   connected = (packetType == RCVD_PKT_CONNECT_SUCCESS);
+  if(connected) {
+    linkBitrate = bitrate;
+  }
   return connected;
   //}
 }
 
+#if HEATPUMP_ENABLE_PROXY
+void HeatPump::connectProxy(HardwareSerial* serial, HardwareSerial* controllerSerial, int bitrate) {
+  _HardSerial = serial;
+  this->controllerSerial = controllerSerial;
+  if(bitrate > 0) {
+    _HardSerial->begin(bitrate, SERIAL_8E1);
+    controllerSerial->begin(bitrate, SERIAL_8E1);
+    linkBitrate = bitrate;
+  }
+  beginBus(BUS_PROXY);
+}
+
+bool HeatPump::isProxy() {
+  return busMode == BUS_PROXY;
+}
+
+void HeatPump::connectListener(HardwareSerial* serial, int bitrate) {
+  _HardSerial = serial;
+  controllerSerial = nullptr;
+  if(bitrate > 0) {
+    _HardSerial->begin(bitrate, SERIAL_8E1);
+    linkBitrate = bitrate;
+  }
+  beginBus(BUS_LISTEN);
+}
+
+bool HeatPump::isListening() {
+  return busMode == BUS_LISTEN;
+}
+
+void HeatPump::setStaleInterval(unsigned long intervalMs) {
+  staleInterval = intervalMs;
+}
+#endif
+
 bool HeatPump::update() {
+#if HEATPUMP_ENABLE_PROXY
+  if(busMode != BUS_DIRECT) {
+    // the bus belongs to the controller, the packet goes out in its next pause.
+    // It is built from all wanted settings, so a newer one replaces one that has not been sent yet
+    byte packet[PACKET_LEN] = {};
+    decodePendingResponses();
+    createPacket(packet, wantedSettings);
+    proxyUpdatePending = true;
+    for (int i = 0; i < txQueueCount; i++) {
+      if (txQueue[i].txClass == TX_CLASS_CONTROL) {
+        memcpy(txQueue[i].data, packet, PACKET_LEN);
+        return true;
+      }
+    }
+    if(!queuePacket(packet, PACKET_LEN, TX_CLASS_CONTROL)) {
+      proxyUpdatePending = false;
+      return false;
+    }
+    return true;
+  }
+#endif
+  unsigned long queued = millis();
   while(!canSend(false)) { delay(10); }
+  recordTx(TX_CLASS_CONTROL, queued);
 
   // Flush the serial buffer before updating settings to clear out
   // any remaining responses that would prevent us from receiving
   // RCVD_PKT_UPDATE_SUCCESS
   readAllPackets();
+  decodePendingResponses();
 
   byte packet[PACKET_LEN] = {};
   createPacket(packet, wantedSettings);
@@ -180,6 +297,7 @@ bool HeatPump::update() {
   int packetType = readPacket();
 
   if(packetType == RCVD_PKT_UPDATE_SUCCESS) {
+    markWantedSent();
     // call sync() to get the latest settings from the heatpump for autoUpdate, which should now have the updated settings
     if(autoUpdate) { //this sync will happen regardless, but autoUpdate needs it sooner than later.
 	    while(!canSend(true)) {
@@ -198,20 +316,80 @@ bool HeatPump::update() {
 }
 
 void HeatPump::sync(byte packetType) {
-  if((!connected) || (millis() - lastRecv > (PACKET_SENT_INTERVAL_MS * 10))) {
+  // a slower idle poll rate, now or for the last poll, stretches the time without a response accordingly
+  unsigned long interval = infoInterval();
+  if(pollInterval > interval) {
+    interval = pollInterval;
+  }
+#if HEATPUMP_ENABLE_LINK_STATS
+  // responses are only read PACKET_SENT_INTERVAL_MS after sending, note when one actually arrived
+  if(waitForRead && responseStarted == 0 && _HardSerial && _HardSerial->available() > 0) {
+    responseStarted = millis();
+  }
+#endif
+#if HEATPUMP_ENABLE_PROXY
+  if(busMode != BUS_DIRECT) {
+    proxySync();
+  }
+  else
+#endif
+  if((!connected) || (millis() - lastRecv > (PACKET_SENT_INTERVAL_MS * 10) +
+                      (interval > PACKET_INFO_INTERVAL_MS ? interval - PACKET_INFO_INTERVAL_MS : 0))) {
+#if HEATPUMP_ENABLE_LINK_STATS
+    if(connected) {
+      linkStats.reconnects++;
+    }
+#endif
     connect(NULL);
   }
   else if(canRead()) {
     readAllPackets();
+    waitForRead = false; // also when nothing came, otherwise this branch would be taken until a reconnect
   }
   else if(autoUpdate && !firstRun && wantedSettings != currentSettings && packetType == PACKET_TYPE_DEFAULT) {
     update();
   }
+  else if(txQueueCount > 0 && canSend(false)) {
+    // commands always take the next bus slot, a due info poll is deferred until the queue is empty
+    if(infoDue == 0 && canSend(true)) {
+      infoDue = millis();
+    }
+    sendQueuedPacket();
+  }
   else if(canSend(true)) {
     byte packet[PACKET_LEN] = {};
+    pollInterval = infoInterval();
+    recordTx(TX_CLASS_INFO, infoDue ? infoDue : millis());
+    infoDue = 0;
+#if HEATPUMP_ENABLE_FUNCTIONS
+    if(packetType != PACKET_TYPE_DEFAULT || !createPendingFunctionsPacket(packet)) {
+      createInfoPacket(packet, packetType);
+    }
+#else
     createInfoPacket(packet, packetType);
+#endif
+#if HEATPUMP_ENABLE_LINK_STATS
+    countPoll(packet[5]);
+#endif
     writePacket(packet, PACKET_LEN);
   }
+
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+  updateRuntimeStats();
+#endif
+#if HEATPUMP_ENABLE_HISTORY
+  // nothing to record until the first room temperature response has been stored
+  if(history && connected && responseObserved(RESPONSE_DECODER_ROOM_TEMP) && responseObserved(RESPONSE_DECODER_STATUS)) {
+    decodePendingResponses();
+    history->record(currentStatus);
+  }
+#endif
+#if HEATPUMP_ENABLE_CHANGE_LOG
+  logChanges();
+#endif
+#if HEATPUMP_ENABLE_SNAPSHOTS
+  publishSnapshot();
+#endif
 }
 
 void HeatPump::enableExternalUpdate() {
@@ -232,10 +410,12 @@ void HeatPump::disableAutoUpdate() {
 }
 
 heatpumpSettings HeatPump::getSettings() {
+  decodePendingResponses();
   return currentSettings;
 }
 
 heatpumpSettings HeatPump::getWantedSettings() {
+  decodePendingResponses();
   return wantedSettings;
 }
 
@@ -251,6 +431,442 @@ bool HeatPump::isConnected() {
   return connected;
 }
 
+unsigned long HeatPump::getDuplicateResponseCount() {
+  return duplicateResponses;
+}
+
+#if HEATPUMP_ENABLE_IDLE_MODE
+void HeatPump::enableIdleMode(unsigned long intervalMs) {
+  idleEnabled = true;
+  // never faster than the regular polls, idle is the slow rate
+  idleInfoInterval = intervalMs < PACKET_INFO_INTERVAL_MS ? PACKET_INFO_INTERVAL_MS : intervalMs;
+}
+
+void HeatPump::disableIdleMode() {
+  idleEnabled = false;
+}
+
+bool HeatPump::isIdle() {
+  if(!idleEnabled || !connected || txQueueCount > 0 || millis() - lastActivity < IDLE_SETTLE_MS) {
+    return false;
+  }
+#if HEATPUMP_ENABLE_FUNCTIONS
+  if(functionsPending) {
+    return false;
+  }
+#endif
+  if(autoUpdate && !firstRun && wantedSettings != currentSettings) {
+    return false;
+  }
+  // the raw power byte, decoding here would run the settings callback from inside canSend()
+  const byte* settings = responseData[RESPONSE_DECODER_SETTINGS];
+  const wireField& power = SETTING_FIELDS[SETTING_POWER];
+  return settings[0] == RESPONSE_DECODERS[RESPONSE_DECODER_SETTINGS].type &&
+         (settings[power.getOffset] & power.getMask) == POWER_VALUES[0].raw;
+}
+#endif
+
+unsigned long HeatPump::getSleepTime() {
+#if HEATPUMP_ENABLE_PROXY
+  if(busMode != BUS_DIRECT) {
+    return 0; // every byte has to be forwarded as it comes
+  }
+#endif
+  if(!connected || _HardSerial == NULL || _HardSerial->available() > 0) {
+    return 0;
+  }
+  if(autoUpdate && !firstRun && wantedSettings != currentSettings) {
+    return 0;
+  }
+
+  // the next thing sync() will do: read the response, send a queued packet, or poll
+  unsigned long wait;
+  if(waitForRead || txQueueCount > 0) {
+    wait = PACKET_SENT_INTERVAL_MS;
+  } else {
+    wait = infoInterval();
+  }
+  unsigned long elapsed = millis() - lastSend;
+  return elapsed > wait ? 0 : wait - elapsed + 1;
+}
+
+#if HEATPUMP_ENABLE_WARM_START
+int HeatPump::saveState(byte* buffer, int length) {
+  if(length < SAVED_STATE_LEN) {
+    return 0;
+  }
+  memset(buffer, 0, SAVED_STATE_LEN);
+  int pos = 0;
+  buffer[pos++] = SAVED_STATE_VERSION;
+  buffer[pos++] = linkBitrate / 100;
+
+  // the last payload of every response type, restoreState() decodes them like fresh responses
+  byte& responseCount = buffer[pos++];
+  for(int i = 0; i < RESPONSE_DECODER_COUNT; i++) {
+    if(responseData[i][0] == RESPONSE_DECODERS[i].type) {
+      memcpy(&buffer[pos], responseData[i], RESPONSE_DATA_LEN);
+      pos += RESPONSE_DATA_LEN;
+      responseCount++;
+    }
+  }
+
+#if HEATPUMP_ENABLE_FUNCTIONS
+  buffer[pos++] = functionsCached;
+  if(functionsCached) {
+    functions.getData1(&buffer[pos]);
+    functions.getData2(&buffer[pos + FUNCTIONS_DATA_LEN]);
+    pos += 2 * FUNCTIONS_DATA_LEN;
+  }
+#endif
+
+  buffer[pos] = checkSum(buffer, pos);
+  return pos + 1;
+}
+
+bool HeatPump::restoreState(const byte* buffer, int length) {
+  if(length < 4 || buffer[0] != SAVED_STATE_VERSION || buffer[length - 1] != checkSum((byte*)buffer, length - 1)) {
+    return false;
+  }
+  int pos = 1;
+  linkBitrate = buffer[pos++] * 100;
+
+  int responseCount = buffer[pos++];
+  for(int n = 0; n < responseCount && pos + RESPONSE_DATA_LEN < length; n++, pos += RESPONSE_DATA_LEN) {
+    for(int i = 0; i < RESPONSE_DECODER_COUNT; i++) {
+      if(RESPONSE_DECODERS[i].type == buffer[pos]) {
+        memcpy(responseData[i], &buffer[pos], RESPONSE_DATA_LEN);
+        staleResponses |= (1 << i);
+        decodeResponse(i);
+      }
+    }
+  }
+  // the first fresh settings packet still initialises wantedSettings, so stale settings are never sent
+  firstRun = true;
+
+#if HEATPUMP_ENABLE_FUNCTIONS
+  if(pos < length - 1 && buffer[pos++] && pos + 2 * FUNCTIONS_DATA_LEN < length) {
+    functions.setData1((byte*)&buffer[pos]);
+    functions.setData2((byte*)&buffer[pos + FUNCTIONS_DATA_LEN]);
+    // function codes are installer settings, the restored ones are served like a fresh fetch until the cache expires
+    functionsCached = true;
+    functionsFetched = millis();
+  }
+#endif
+  return true;
+}
+
+bool HeatPump::isStale() {
+  // a type that is not polled (timers with setFastSync()) would stay stale forever
+  for(int i = 0; i < RESPONSE_DECODER_COUNT; i++) {
+    if((staleResponses & (1 << i)) && isPolled(RESPONSE_DECODERS[i].type)) {
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+void HeatPump::enableRuntimeStats() {
+  runtimeStatsEnabled = true;
+}
+
+heatpumpRuntimeStats HeatPump::getRuntimeStats() {
+  return runtimeStats;
+}
+
+void HeatPump::setRuntimeStats(const heatpumpRuntimeStats& stats) {
+  runtimeStats = stats;
+}
+
+void HeatPump::resetRuntimeStats() {
+  runtimeStats = heatpumpRuntimeStats {};
+  observedMs = operatingMs = frequencyMs = 0;
+  energyWms = 0;
+}
+
+float HeatPump::getAverageFrequency() {
+  if (runtimeStats.operatingSeconds == 0) {
+    return 0;
+  }
+  return (float)runtimeStats.frequencySeconds / runtimeStats.operatingSeconds;
+}
+
+void HeatPump::setShortCycleThreshold(unsigned long ms) {
+  shortCycleMs = ms;
+}
+
+void HeatPump::setPowerModel(float idleWatts, float runningWatts, float wattsPerHz) {
+  this->idleWatts = idleWatts;
+  this->runningWatts = runningWatts;
+  this->wattsPerHz = wattsPerHz;
+}
+
+void HeatPump::setRuntimeStatsCallback(RUNTIME_STATS_CALLBACK_SIGNATURE, unsigned long intervalMs) {
+  this->runtimeStatsCallback = runtimeStatsCallback;
+  runtimeStatsSaveMs = intervalMs;
+}
+
+// adds amount to carry and moves every whole unit of it into total
+void HeatPump::addCarry(unsigned long& total, unsigned long& carry, unsigned long amount, unsigned long unit) {
+  carry += amount;
+  total += carry / unit;
+  carry %= unit;
+}
+
+// integrates the status since the previous call, O(1) per call
+void HeatPump::updateRuntimeStats() {
+  if (!runtimeStatsEnabled) {
+    return;
+  }
+  unsigned long now = millis();
+  unsigned long elapsed = now - runtimeUpdated;
+
+  if (runtimeKnown && connected && elapsed < RUNTIME_STATS_GAP_MS) {
+    addCarry(runtimeStats.observedSeconds, observedMs, elapsed, 1000);
+    float watts = idleWatts;
+    if (runtimeOperating) {
+      addCarry(runtimeStats.operatingSeconds, operatingMs, elapsed, 1000);
+      addCarry(runtimeStats.frequencySeconds, frequencyMs, elapsed * currentStatus.compressorFrequency, 1000);
+      watts = runningWatts + wattsPerHz * currentStatus.compressorFrequency;
+    }
+    energyWms += watts * elapsed;
+    if (energyWms >= 3600000) {
+      unsigned long wh = energyWms / 3600000;
+      runtimeStats.energyWh += wh;
+      energyWms -= wh * 3600000.0;
+    }
+  }
+  runtimeUpdated = now;
+
+  // the status is unknown until the first status response after connecting, a restored one does not count
+  bool known = connected && responseObserved(RESPONSE_DECODER_STATUS);
+  if (known && !runtimeKnown) {
+    // a period that was already running is not counted as a cycle
+    runtimeOperating = currentStatus.operating;
+    runtimeStarted = 0;
+  } else if (known && currentStatus.operating != runtimeOperating) {
+    if (currentStatus.operating) {
+      runtimeStats.cycles++;
+      runtimeStarted = now;
+    } else if (runtimeStarted != 0 && now - runtimeStarted < shortCycleMs) {
+      runtimeStats.shortCycles++;
+    }
+    runtimeOperating = currentStatus.operating;
+  }
+  runtimeKnown = known;
+
+  if (runtimeStatsCallback && now - runtimeSaved >= runtimeStatsSaveMs) {
+    runtimeSaved = now;
+    runtimeStatsCallback(runtimeStats);
+  }
+}
+#endif
+
+#if HEATPUMP_ENABLE_HISTORY
+void HeatPump::setHistory(HeatPumpHistory* history) {
+  this->history = history;
+}
+#endif
+
+#if HEATPUMP_ENABLE_CHANGE_LOG
+void HeatPump::enableChangeLog() {
+  changeLogEnabled = true;
+}
+
+unsigned long HeatPump::getChangeSequence() {
+  return changeSequence;
+}
+
+int HeatPump::getChanges(unsigned long sinceSequence, heatpumpChange changes[], int maxChanges) {
+  if (sinceSequence > changeSequence || changeSequence - sinceSequence > HEATPUMP_CHANGE_LOG_LEN) {
+    return CHANGES_LOST;
+  }
+
+  int count = 0;
+  for (unsigned long sequence = sinceSequence + 1; sequence <= changeSequence && count < maxChanges; sequence++) {
+    changes[count++] = changeLog[sequence % HEATPUMP_CHANGE_LOG_LEN];
+  }
+  return count;
+}
+
+void HeatPump::logChange(byte field, const char* text, float value) {
+  changeSequence++;
+  heatpumpChange& change = changeLog[changeSequence % HEATPUMP_CHANGE_LOG_LEN];
+  change.sequence = changeSequence;
+  change.field = field;
+  change.text = text;
+  change.value = value;
+}
+
+void HeatPump::logChanges() {
+  if (!changeLogEnabled) {
+    return;
+  }
+  decodePendingResponses();
+
+  if (connected != loggedConnected) {
+    loggedConnected = connected;
+    logChange(CHANGE_CONNECTED, nullptr, connected);
+  }
+
+  // CHANGE_POWER..CHANGE_WIDEVANE are the SETTING_FIELDS indexes
+  for (int i = 0; i < SETTING_FIELD_COUNT; i++) {
+    const char* heatpumpSettings::*setting = SETTING_FIELDS[i].setting;
+    if (currentSettings.*setting != loggedSettings.*setting) {
+      loggedSettings.*setting = currentSettings.*setting;
+      logChange(i, currentSettings.*setting, 0);
+    }
+  }
+  if (currentSettings.temperature != loggedSettings.temperature) {
+    loggedSettings.temperature = currentSettings.temperature;
+    logChange(CHANGE_TEMPERATURE, nullptr, currentSettings.temperature);
+  }
+
+  if (currentStatus.roomTemperature != loggedStatus.roomTemperature) {
+    loggedStatus.roomTemperature = currentStatus.roomTemperature;
+    logChange(CHANGE_ROOM_TEMPERATURE, nullptr, currentStatus.roomTemperature);
+  }
+  if (currentStatus.operating != loggedStatus.operating) {
+    loggedStatus.operating = currentStatus.operating;
+    logChange(CHANGE_OPERATING, nullptr, currentStatus.operating);
+  }
+  if (currentStatus.compressorFrequency != loggedStatus.compressorFrequency) {
+    loggedStatus.compressorFrequency = currentStatus.compressorFrequency;
+    logChange(CHANGE_COMPRESSOR_FREQUENCY, nullptr, currentStatus.compressorFrequency);
+  }
+
+#if HEATPUMP_ENABLE_TIMERS
+  const heatpumpTimers& timers = currentStatus.timers;
+  heatpumpTimers& logged = loggedStatus.timers;
+  if (timers.mode != logged.mode) {
+    logChange(CHANGE_TIMER_MODE, timers.mode, 0);
+  }
+  if (timers.onMinutesSet != logged.onMinutesSet) {
+    logChange(CHANGE_TIMER_ON_SET, nullptr, timers.onMinutesSet);
+  }
+  if (timers.onMinutesRemaining != logged.onMinutesRemaining) {
+    logChange(CHANGE_TIMER_ON_REMAINING, nullptr, timers.onMinutesRemaining);
+  }
+  if (timers.offMinutesSet != logged.offMinutesSet) {
+    logChange(CHANGE_TIMER_OFF_SET, nullptr, timers.offMinutesSet);
+  }
+  if (timers.offMinutesRemaining != logged.offMinutesRemaining) {
+    logChange(CHANGE_TIMER_OFF_REMAINING, nullptr, timers.offMinutesRemaining);
+  }
+  logged = timers;
+#endif
+}
+#endif
+
+#if HEATPUMP_ENABLE_SNAPSHOTS
+// AVR boards run a single thread, elsewhere the version is published with release/acquire ordering
+#if defined(__AVR__)
+#define SNAPSHOT_LOAD(version) (version)
+#define SNAPSHOT_STORE(version, value) ((version) = (value))
+#define SNAPSHOT_READ_FENCE()
+#define SNAPSHOT_WRITE_FENCE()
+#else
+#define SNAPSHOT_LOAD(version) __atomic_load_n(&(version), __ATOMIC_ACQUIRE)
+#define SNAPSHOT_STORE(version, value) __atomic_store_n(&(version), (value), __ATOMIC_RELEASE)
+#define SNAPSHOT_READ_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define SNAPSHOT_WRITE_FENCE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#endif
+
+void HeatPump::enableSnapshots() {
+  snapshotsEnabled = true;
+}
+
+unsigned long HeatPump::getSnapshotVersion() {
+  return SNAPSHOT_LOAD(snapshotVersion);
+}
+
+bool HeatPump::getSnapshot(heatpumpSnapshot& snapshot, unsigned long sinceVersion) {
+  unsigned long version;
+  do {
+    version = SNAPSHOT_LOAD(snapshotVersion);
+    if (version == sinceVersion) {
+      return false;
+    }
+    snapshot = snapshots[version & 1];
+    SNAPSHOT_READ_FENCE();
+    // publishSnapshot() only writes a buffer after moving the version past it, so an unchanged
+    // version means the copy was not torn
+  } while (SNAPSHOT_LOAD(snapshotVersion) != version);
+  return true;
+}
+
+void HeatPump::publishSnapshot() {
+  if (!snapshotsEnabled) {
+    return;
+  }
+  decodePendingResponses();
+
+  const heatpumpSnapshot& last = snapshots[snapshotVersion & 1];
+  bool changed = snapshotVersion == 0 ||
+                 last.connected != connected ||
+                 last.settings != currentSettings ||
+                 last.wantedSettings != wantedSettings ||
+                 last.status != currentStatus;
+#if HEATPUMP_ENABLE_FUNCTIONS
+  changed = changed || last.functionsValid != functionsCached || (functionsCached && functions != last.functions);
+#endif
+  if (!changed) {
+    return;
+  }
+
+  // fill the buffer readers are not using, then switch them over. The release store of the previous
+  // version does not keep these writes behind it, the fence does, so a reader still on that buffer
+  // sees the version move before it can see any of the new data
+  SNAPSHOT_WRITE_FENCE();
+  unsigned long next = snapshotVersion + 1;
+  heatpumpSnapshot& snapshot = snapshots[next & 1];
+  snapshot.version = next;
+  snapshot.connected = connected;
+  snapshot.settings = currentSettings;
+  snapshot.wantedSettings = wantedSettings;
+  snapshot.status = currentStatus;
+#if HEATPUMP_ENABLE_FUNCTIONS
+  snapshot.functionsValid = functionsCached;
+  if (functionsCached) {
+    snapshot.functions = functions;
+  }
+#endif
+  SNAPSHOT_STORE(snapshotVersion, next);
+}
+#endif
+
+#if HEATPUMP_ENABLE_LINK_STATS
+heatpumpLinkStats HeatPump::getLinkStats() {
+  static_assert(HEATPUMP_POLL_TYPES == INFOMODE_LEN + 1, "one poll counter per INFOMODE code and one for functions");
+  return linkStats;
+}
+
+byte HeatPump::getPollCode(int pollType) {
+  if(pollType >= 0 && pollType < INFOMODE_LEN) {
+    return INFOMODE[pollType];
+  }
+  return pollType == INFOMODE_LEN ? 0x20 : 0; // FUNCTIONS_GET_PART1, part 2 is counted with it
+}
+
+void HeatPump::countPoll(byte code) {
+  for(int i = 0; i < INFOMODE_LEN; i++) {
+    if(INFOMODE[i] == code) {
+      linkStats.polls[i]++;
+      return;
+    }
+  }
+  linkStats.polls[INFOMODE_LEN]++; // function codes, part 1 or 2
+}
+#endif
+
+heatpumpTxStats HeatPump::getTxStats(int txClass) {
+  if (txClass < TX_CLASS_CONTROL || txClass > TX_CLASS_INFO) {
+    return heatpumpTxStats {};
+  }
+  return txStats[txClass];
+}
+
 void HeatPump::setSettings(heatpumpSettings settings) {
   setPowerSetting(settings.power);
   setModeSetting(settings.mode);
@@ -261,49 +877,45 @@ void HeatPump::setSettings(heatpumpSettings settings) {
 }
 
 bool HeatPump::getPowerSettingBool() {
-  return currentSettings.power == POWER_MAP[1] ? true : false;
+  decodePendingResponses();
+  return currentSettings.power == POWER_VALUES[1].name ? true : false;
 }
 
 void HeatPump::setPowerSetting(bool setting) {
-  wantedSettings.power = lookupByteMapIndex(POWER_MAP, 2, POWER_MAP[setting ? 1 : 0]) > -1 ? POWER_MAP[setting ? 1 : 0] : POWER_MAP[0];
-  lastWanted = millis();
+  wantedSettings.power = POWER_VALUES[setting ? 1 : 0].name;
+  markWanted(SETTING_POWER);
 }
 
 const char* HeatPump::getPowerSetting() {
+  decodePendingResponses();
   return currentSettings.power;
 }
 
 void HeatPump::setPowerSetting(const char* setting) {
-  int index = lookupByteMapIndex(POWER_MAP, 2, setting);
-  if (index > -1) {
-    wantedSettings.power = POWER_MAP[index];
-  } else {
-    wantedSettings.power = POWER_MAP[0];
-  }
-  lastWanted = millis();
+  wantedSettings.power = lookupWireName(POWER_VALUES, 2, setting)->name;
+  markWanted(SETTING_POWER);
 }
 
 const char* HeatPump::getModeSetting() {
+  decodePendingResponses();
   return currentSettings.mode;
 }
 
 void HeatPump::setModeSetting(const char* setting) {
-  int index = lookupByteMapIndex(MODE_MAP, 5, setting);
-  if (index > -1) {
-    wantedSettings.mode = MODE_MAP[index];
-  } else {
-    wantedSettings.mode = MODE_MAP[0];
-  }
-  lastWanted = millis();
+  wantedSettings.mode = lookupWireName(MODE_VALUES, 5, setting)->name;
+  markWanted(SETTING_MODE);
 }
 
 float HeatPump::getTemperature() {
+  decodePendingResponses();
   return currentSettings.temperature;
 }
 
 void HeatPump::setTemperature(float setting) {
+  decodePendingResponses();
   if(!tempMode){
-    wantedSettings.temperature = lookupByteMapIndex(TEMP_MAP, 16, (int)(setting + 0.5)) > -1 ? setting : TEMP_MAP[0];
+    int temp = (int)(setting + 0.5);
+    wantedSettings.temperature = (temp >= 16 && temp <= 31) ? setting : 31;
   }
   else {
     setting = setting * 2;
@@ -311,10 +923,10 @@ void HeatPump::setTemperature(float setting) {
     setting = setting / 2;
     wantedSettings.temperature = setting < 10 ? 10 : (setting > 31 ? 31 : setting);
   }
-  lastWanted = millis();
+  markWanted(SETTING_TEMPERATURE);
 }
 
-void HeatPump::setRemoteTemperature(float setting) {
+bool HeatPump::setRemoteTemperature(float setting) {
   byte packet[PACKET_LEN] = {};
   
   prepareSetPacket(packet, PACKET_LEN);
@@ -337,69 +949,69 @@ void HeatPump::setRemoteTemperature(float setting) {
   // add the checksum
   byte chkSum = checkSum(packet, 21);
   packet[21] = chkSum;
-  while(!canSend(false)) { delay(10); }
-  writePacket(packet, PACKET_LEN);
+
+  // only the latest remote temperature matters, replace one that has not been sent yet
+  for (int i = 0; i < txQueueCount; i++) {
+    if (txQueue[i].txClass == TX_CLASS_REMOTE_TEMP) {
+      memcpy(txQueue[i].data, packet, PACKET_LEN);
+      return true;
+    }
+  }
+  return queuePacket(packet, PACKET_LEN, TX_CLASS_REMOTE_TEMP);
 }
 
 const char* HeatPump::getFanSpeed() {
+  decodePendingResponses();
   return currentSettings.fan;
 }
 
 
 void HeatPump::setFanSpeed(const char* setting) {
-  int index = lookupByteMapIndex(FAN_MAP, 6, setting);
-  if (index > -1) {
-    wantedSettings.fan = FAN_MAP[index];
-  } else {
-    wantedSettings.fan = FAN_MAP[0];
-  }
-  lastWanted = millis();
+  wantedSettings.fan = lookupWireName(FAN_VALUES, 6, setting)->name;
+  markWanted(SETTING_FAN);
 }
 
 const char* HeatPump::getVaneSetting() {
+  decodePendingResponses();
   return currentSettings.vane;
 }
 
 void HeatPump::setVaneSetting(const char* setting) {
-  int index = lookupByteMapIndex(VANE_MAP, 7, setting);
-  if (index > -1) {
-    wantedSettings.vane = VANE_MAP[index];
-  } else {
-    wantedSettings.vane = VANE_MAP[0];
-  }
-  lastWanted = millis();
+  wantedSettings.vane = lookupWireName(VANE_VALUES, 7, setting)->name;
+  markWanted(SETTING_VANE);
 }
 
 const char* HeatPump::getWideVaneSetting() {
+  decodePendingResponses();
   return currentSettings.wideVane;
 }
 
 void HeatPump::setWideVaneSetting(const char* setting) {
-  int index = lookupByteMapIndex(WIDEVANE_MAP, 7, setting);
-  if (index > -1) {
-    wantedSettings.wideVane = WIDEVANE_MAP[index];
-  } else {
-    wantedSettings.wideVane = WIDEVANE_MAP[0];
-  }
-  lastWanted = millis();
+  wantedSettings.wideVane = lookupWireName(WIDEVANE_VALUES, 7, setting)->name;
+  markWanted(SETTING_WIDEVANE);
 }
 
 bool HeatPump::getIseeBool() { //no setter yet
+  decodePendingResponses();
   return currentSettings.iSee;
 }
 
 heatpumpStatus HeatPump::getStatus() {
+  decodePendingResponses();
   return currentStatus;
 }
 
 float HeatPump::getRoomTemperature() {
+  decodePendingResponses();
   return currentStatus.roomTemperature;
 }
 
 bool HeatPump::getOperating() {
+  decodePendingResponses();
   return currentStatus.operating;
 }
 
+#if HEATPUMP_ENABLE_FAHRENHEIT
 float HeatPump::FahrenheitToCelsius(int tempF) {
   float temp = (tempF - 32) / 1.8;                
   return ((float)round(temp*2))/2;                 //Round to nearest 0.5C
@@ -409,6 +1021,7 @@ int HeatPump::CelsiusToFahrenheit(float tempC) {
   float temp = (tempC * 1.8) + 32;                //round up if heat, down if cool or any other mode
   return (int)(temp + 0.5);
 }
+#endif
 
 void HeatPump::setOnConnectCallback(ON_CONNECT_CALLBACK_SIGNATURE) {
   this->onConnectCallback = onConnectCallback;
@@ -422,25 +1035,64 @@ void HeatPump::setStatusChangedCallback(STATUS_CHANGED_CALLBACK_SIGNATURE) {
   this->statusChangedCallback = statusChangedCallback;
 }
 
+#if HEATPUMP_ENABLE_PACKET_CALLBACK
 void HeatPump::setPacketCallback(PACKET_CALLBACK_SIGNATURE) {
   this->packetCallback = packetCallback;
 }
+#endif
 
+#if HEATPUMP_ENABLE_ROOM_TEMP_CALLBACK
 void HeatPump::setRoomTempChangedCallback(ROOM_TEMP_CHANGED_CALLBACK_SIGNATURE) {
   this->roomTempChangedCallback = roomTempChangedCallback;
 }
+#endif
 
-//#### WARNING, THE FOLLOWING METHOD CAN F--K YOUR HP UP, USE WISELY ####
-void HeatPump::sendCustomPacket(byte data[], int packetLength) {
-  while(!canSend(false)) { delay(10); }
+#if HEATPUMP_ENABLE_FUNCTIONS
+void HeatPump::setFunctionsCallback(FUNCTIONS_CALLBACK_SIGNATURE) {
+  this->functionsCallback = functionsCallback;
+}
+#endif
 
+#if HEATPUMP_ENABLE_RESPONSE_HANDLERS
+bool HeatPump::setResponseHandler(byte responseType, RESPONSE_CALLBACK_SIGNATURE) {
+  for (int i = 0; i < responseHandlerCount; i++) {
+    if (responseHandlers[i].type == responseType) {
+      if (responseCallback) {
+        responseHandlers[i].responseCallback = responseCallback;
+      } else {
+        // remove the handler, keep the table packed
+        for (int j = i; j < responseHandlerCount - 1; j++) {
+          responseHandlers[j] = responseHandlers[j + 1];
+        }
+        responseHandlers[--responseHandlerCount].responseCallback = nullptr;
+      }
+      return true;
+    }
+  }
+
+  if (!responseCallback) {
+    return true;
+  }
+  if (responseHandlerCount >= MAX_RESPONSE_HANDLERS) {
+    return false;
+  }
+  responseHandlers[responseHandlerCount].type = responseType;
+  responseHandlers[responseHandlerCount].responseCallback = responseCallback;
+  responseHandlerCount++;
+  return true;
+}
+#endif
+
+#if HEATPUMP_ENABLE_CUSTOM_PACKETS
+//#### WARNING, THE FOLLOWING METHOD CAN F--K YOUR HP UP, USE WISELY ####
+bool HeatPump::sendCustomPacket(byte data[], int packetLength) {
   packetLength += 2; // +2 for first header byte and checksum
   packetLength = (packetLength > PACKET_LEN) ? PACKET_LEN : packetLength; // ensure we are not exceeding PACKET_LEN
-  byte packet[packetLength];
+  byte packet[PACKET_LEN];
   packet[0] = HEADER[0]; // add first header byte
 
   // add data
-  for (int i = 0; i < packetLength; i++) {
+  for (int i = 0; i < packetLength - 2; i++) {
     packet[(i+1)] = data[i]; 
   }
 
@@ -448,52 +1100,107 @@ void HeatPump::sendCustomPacket(byte data[], int packetLength) {
   byte chkSum = checkSum(packet, (packetLength-1));
   packet[(packetLength-1)] = chkSum;
 
-  writePacket(packet, packetLength);
+  return queuePacket(packet, packetLength, TX_CLASS_CUSTOM);
 }
+#endif
 
 // Private Methods //////////////////////////////////////////////////////////////
 
-int HeatPump::lookupByteMapIndex(const int valuesMap[], int len, int lookupValue) {
+const HeatPump::wireValue* HeatPump::lookupWireValue(const wireValue values[], int len, byte raw) {
   for (int i = 0; i < len; i++) {
-    if (valuesMap[i] == lookupValue) {
-      return i;
+    if (values[i].raw == raw) {
+      return &values[i];
     }
   }
-  return -1;
+  return &values[0];
 }
 
-int HeatPump::lookupByteMapIndex(const char* valuesMap[], int len, const char* lookupValue) {
+const HeatPump::wireValue* HeatPump::lookupWireName(const wireValue values[], int len, const char* name) {
   for (int i = 0; i < len; i++) {
-    if (strcasecmp(valuesMap[i], lookupValue) == 0) {
-      return i;
+    // wanted and current settings point into the tables, so most lookups match on the pointer
+    if (values[i].name == name || (name && strcasecmp(values[i].name, name) == 0)) {
+      return &values[i];
     }
   }
-  return -1;
+  return &values[0];
 }
 
+void HeatPump::markWanted(int field) {
+  lastWanted = millis();
+  wantedChanged[field] = ++settingsEvents;
+  wantedPolls[field] = 0;
+#if HEATPUMP_ENABLE_IDLE_MODE
+  lastActivity = lastWanted;
+#endif
+}
 
-const char* HeatPump::lookupByteMapValue(const char* valuesMap[], const byte byteMap[], int len, byte byteValue) {
-  for (int i = 0; i < len; i++) {
-    if (byteMap[i] == byteValue) {
-      return valuesMap[i];
+void HeatPump::reconcileWantedSettings(const heatpumpSettings& previous, const heatpumpSettings& received) {
+  // Last writer wins, per field. A field that changed on the unit since the previous settings packet was
+  // changed by someone else (IR remote, wall controller) somewhere after settingsObserved. It replaces the
+  // wanted value unless that was set locally after settingsObserved, in which case the local write is
+  // at least as recent and is kept (autoUpdate will send it).
+  for(int i = 0; i < SETTING_FIELD_COUNT; i++) {
+    const char* heatpumpSettings::*setting = SETTING_FIELDS[i].setting;
+    if(received.*setting != previous.*setting && wantedChanged[i] <= settingsObserved) {
+      wantedSettings.*setting = received.*setting;
     }
   }
-  return valuesMap[0];
+  if(received.temperature != previous.temperature && wantedChanged[SETTING_TEMPERATURE] <= settingsObserved) {
+    wantedSettings.temperature = received.temperature;
+  }
 }
 
-int HeatPump::lookupByteMapValue(const int valuesMap[], const byte byteMap[], int len, byte byteValue) {
-  for (int i = 0; i < len; i++) {
-    if (byteMap[i] == byteValue) {
-      return valuesMap[i];
+bool HeatPump::wantedDiffers(int field) {
+  if(field == SETTING_TEMPERATURE) {
+    return wantedSettings.temperature != currentSettings.temperature;
+  }
+  const char* heatpumpSettings::*setting = SETTING_FIELDS[field].setting;
+  return wantedSettings.*setting != currentSettings.*setting;
+}
+
+// the unit acknowledged a set packet, every field it carried waits for the polls to show it
+void HeatPump::markWantedSent() {
+  for(int i = 0; i <= SETTING_TEMPERATURE; i++) {
+    if(wantedPolls[i] == 0 && wantedDiffers(i)) {
+      wantedPolls[i] = 1;
+    }
+  }
+}
+
+// a settings packet from the unit, decoded into currentSettings or identical to the previous one
+void HeatPump::observeSettings() {
+  settingsObserved = settingsEvents;
+  for(int i = 0; i <= SETTING_TEMPERATURE; i++) {
+    if(wantedPolls[i] == 0) {
+      continue;
+    }
+    if(!wantedDiffers(i)) {
+      wantedPolls[i] = 0; // applied
+    } else if(wantedPolls[i]++ >= WANTED_MAX_POLLS) {
+      // acknowledged but not applied, the unit does not support this value
+      if(i == SETTING_TEMPERATURE) {
+        wantedSettings.temperature = currentSettings.temperature;
+      } else {
+        wantedSettings.*SETTING_FIELDS[i].setting = currentSettings.*SETTING_FIELDS[i].setting;
+      }
+      wantedPolls[i] = 0;
     }
   }
-  return valuesMap[0];
 }
 
 bool HeatPump::canSend(bool isInfo) {
-  return (millis() - (isInfo ? PACKET_INFO_INTERVAL_MS : PACKET_SENT_INTERVAL_MS)) > lastSend;
+  return (millis() - (isInfo ? infoInterval() : PACKET_SENT_INTERVAL_MS)) > lastSend;
 }  
 
+unsigned long HeatPump::infoInterval() {
+#if HEATPUMP_ENABLE_IDLE_MODE
+  if(isIdle()) {
+    return idleInfoInterval;
+  }
+#endif
+  return PACKET_INFO_INTERVAL_MS;
+}
+
 bool HeatPump::canRead() {
   return (waitForRead && (millis() - PACKET_SENT_INTERVAL_MS) > lastSend);
 }
@@ -509,34 +1216,23 @@ byte HeatPump::checkSum(byte bytes[], int len) {
 void HeatPump::createPacket(byte *packet, heatpumpSettings settings) {
   prepareSetPacket(packet, PACKET_LEN);
   
-  if(settings.power != currentSettings.power) {
-    packet[8]  = POWER[lookupByteMapIndex(POWER_MAP, 2, settings.power)];
-    packet[6] += CONTROL_PACKET_1[0];
-  }
-  if(settings.mode!= currentSettings.mode) {
-    packet[9]  = MODE[lookupByteMapIndex(MODE_MAP, 5, settings.mode)];
-    packet[6] += CONTROL_PACKET_1[1];
-  }
-  if(!tempMode && settings.temperature!= currentSettings.temperature) {
-    packet[10] = TEMP[lookupByteMapIndex(TEMP_MAP, 16, settings.temperature)];
-    packet[6] += CONTROL_PACKET_1[2];
-  }
-  else if(tempMode && settings.temperature!= currentSettings.temperature) {
-    float temp = (settings.temperature * 2) + 128;
-    packet[19] = (int)temp;
-    packet[6] += CONTROL_PACKET_1[2];
-  }
-  if(settings.fan!= currentSettings.fan) {
-    packet[11] = FAN[lookupByteMapIndex(FAN_MAP, 6, settings.fan)];
-    packet[6] += CONTROL_PACKET_1[3];
+  for(int i = 0; i < SETTING_FIELD_COUNT; i++) {
+    const wireField& field = SETTING_FIELDS[i];
+    if(settings.*field.setting != currentSettings.*field.setting) {
+      packet[field.setOffset] = lookupWireName(field.values, field.valueCount, settings.*field.setting)->raw;
+      packet[field.controlOffset] |= field.controlFlag;
+    }
   }
-  if(settings.vane!= currentSettings.vane) {
-    packet[12] = VANE[lookupByteMapIndex(VANE_MAP, 7, settings.vane)];
-    packet[6] += CONTROL_PACKET_1[4];
+  if(packet[SETTING_FIELDS[SETTING_WIDEVANE].controlOffset] & SETTING_FIELDS[SETTING_WIDEVANE].controlFlag) {
+    packet[SETTING_FIELDS[SETTING_WIDEVANE].setOffset] |= (wideVaneAdj ? WIDEVANE_ADJ : 0x00);
   }
-  if(settings.wideVane!= currentSettings.wideVane) {
-    packet[18] = WIDEVANE[lookupByteMapIndex(WIDEVANE_MAP, 7, settings.wideVane)] | (wideVaneAdj ? 0x80 : 0x00);
-    packet[7] += CONTROL_PACKET_2[0];
+  if(settings.temperature != currentSettings.temperature) {
+    if(!tempMode) {
+      packet[10] = tempToWire(settings.temperature);
+    } else {
+      packet[19] = halfDegreeToWire(settings.temperature);
+    }
+    packet[6] |= CONTROL_TEMP;
   }
   // add the checksum
   byte chkSum = checkSum(packet, 21);
@@ -568,21 +1264,99 @@ void HeatPump::createInfoPacket(byte *packet, byte packetType) {
     packet[i + 6] = 0x00;
   }
 
-  // add the checksum
-  byte chkSum = checkSum(packet, 21);
-  packet[21] = chkSum;
+  // add the checksum, only the mode byte is not known at compile time
+  packet[21] = (0xfc - INFOHEADER_SUM - packet[5]) & 0xff;
 }
 
+#if HEATPUMP_ENABLE_FUNCTIONS
+void HeatPump::createFunctionsInfoPacket(byte *packet, byte functionsPart) {
+  prepareInfoPacket(packet, PACKET_LEN);
+  packet[5] = functionsPart;
+  packet[21] = (0xfc - INFOHEADER_SUM - functionsPart) & 0xff;
+}
+#endif
+
 void HeatPump::writePacket(byte *packet, int length) {
   for (int i = 0; i < length; i++) {
      _HardSerial->write((uint8_t)packet[i]);
   }
 
+#if HEATPUMP_ENABLE_PACKET_CALLBACK
   if(packetCallback) {
     packetCallback(packet, length, (char*)"packetSent");
   }
+#endif
   waitForRead = true;
   lastSend = millis();
+#if HEATPUMP_ENABLE_LINK_STATS
+  responseStarted = 0;
+#endif
+}
+
+bool HeatPump::queuePacket(byte *packet, int length, int txClass) {
+  // never drop a command, if the queue is full make room by sending the head
+  while (txQueueCount >= TX_QUEUE_LEN) {
+#if HEATPUMP_ENABLE_PROXY
+    if(busMode != BUS_DIRECT) {
+      // the bus is the controller's, waiting for a pause here could take seconds and would run the
+      // callbacks from inside a setter. One of our own polls can go, it is asked again later, the oldest
+      // first; a command is refused
+      int info = -1;
+      for (int i = 0; i < txQueueCount && info < 0; i++) {
+        if (txQueue[i].txClass == TX_CLASS_INFO) {
+          info = i;
+        }
+      }
+      if(info < 0) {
+        return false;
+      }
+      for (int i = info; i < txQueueCount - 1; i++) {
+        txQueue[i] = txQueue[i + 1];
+      }
+      txQueueCount--;
+      continue;
+    }
+#endif
+    while(!canSend(false)) { delay(10); }
+    readAllPackets();
+    sendQueuedPacket();
+  }
+
+  txPacket& tx = txQueue[txQueueCount++];
+  memcpy(tx.data, packet, length);
+  tx.length = length;
+  tx.txClass = txClass;
+  tx.queued = millis();
+  return true;
+}
+
+void HeatPump::sendQueuedPacket() {
+  // highest priority class first, oldest first within a class
+  int next = 0;
+  for (int i = 1; i < txQueueCount; i++) {
+    if (txQueue[i].txClass < txQueue[next].txClass) {
+      next = i;
+    }
+  }
+
+  txPacket tx = txQueue[next];
+  for (int i = next; i < txQueueCount - 1; i++) {
+    txQueue[i] = txQueue[i + 1];
+  }
+  txQueueCount--;
+
+  recordTx(tx.txClass, tx.queued);
+  writePacket(tx.data, tx.length);
+}
+
+void HeatPump::recordTx(int txClass, unsigned long queued) {
+  unsigned long wait = millis() - queued;
+  heatpumpTxStats& stats = txStats[txClass];
+  stats.sent++;
+  stats.totalWaitMs += wait;
+  if (wait > stats.maxWaitMs) {
+    stats.maxWaitMs = wait;
+  }
 }
 
 int HeatPump::readPacket() {
@@ -592,6 +1366,11 @@ int HeatPump::readPacket() {
   int dataSum = 0;
   byte checksum = 0;
   byte dataLength = 0;
+#if HEATPUMP_ENABLE_LINK_STATS
+  bool awaited = waitForRead;
+  unsigned long started = responseStarted;
+  responseStarted = 0;
+#endif
   
   waitForRead = false;
 
@@ -601,6 +1380,11 @@ int HeatPump::readPacket() {
       header[0] = _HardSerial->read();
       if(header[0] == HEADER[0]) {
         foundStart = true;
+#if HEATPUMP_ENABLE_LINK_STATS
+        if(started == 0) {
+          started = millis(); // before the settle delay, which is not part of the round trip
+        }
+#endif
         delay(100); // found that this delay increases accuracy when reading, might not be needed though
       }
     }
@@ -639,159 +1423,314 @@ int HeatPump::readPacket() {
       checksum = (0xfc - dataSum) & 0xff;
 
       if(data[dataLength] == checksum) {
-        lastRecv = millis();
-        if(packetCallback) {
-          byte packet[37]; // we are going to put header[5] and data[32] into this, so the whole packet is sent to the callback
-          for(int i=0; i<INFOHEADER_LEN; i++) {
-            packet[i] = header[i];
-          }
-          for(int i=0; i<(dataLength+1); i++) { //must be dataLength+1 to pick up checksum byte
-            packet[(i+5)] = data[i];
+#if HEATPUMP_ENABLE_LINK_STATS
+        if(awaited) {
+          unsigned long rtt = started - lastSend;
+          linkStats.lastRttMs = rtt;
+          linkStats.totalRttMs += rtt;
+          linkStats.rttSamples++;
+          if(rtt > linkStats.maxRttMs) {
+            linkStats.maxRttMs = rtt;
           }
-          packetCallback(packet, PACKET_LEN, (char*)"packetRecv");
         }
+#endif
+        return decodePacket(header, data, dataLength);
+      }
+#if HEATPUMP_ENABLE_LINK_STATS
+      else {
+        linkStats.checksumErrors++;
+      }
+    } else {
+      linkStats.headerErrors++;
+#endif
+    }
+  }
 
-        if(header[1] == 0x62) {
-          switch(data[0]) {
-            case 0x02: { // setting information
-              heatpumpSettings receivedSettings;
-              receivedSettings.power       = lookupByteMapValue(POWER_MAP, POWER, 2, data[3]);
-              receivedSettings.iSee = data[4] > 0x08 ? true : false;
-              receivedSettings.mode = lookupByteMapValue(MODE_MAP, MODE, 5, receivedSettings.iSee  ? (data[4] - 0x08) : data[4]);
-
-              if(data[11] != 0x00) {
-                int temp = data[11];
-                temp -= 128;
-                receivedSettings.temperature = (float)temp / 2;
-                tempMode =  true;
-              } else {
-                receivedSettings.temperature = lookupByteMapValue(TEMP_MAP, TEMP, 16, data[5]);
-              }
-
-              receivedSettings.fan         = lookupByteMapValue(FAN_MAP, FAN, 6, data[6]);
-              receivedSettings.vane        = lookupByteMapValue(VANE_MAP, VANE, 7, data[7]);
-              receivedSettings.wideVane    = lookupByteMapValue(WIDEVANE_MAP, WIDEVANE, 7, data[10] & 0x0F);
-		      wideVaneAdj = (data[10] & 0xF0) == 0x80 ? true : false;
-              
-              if(settingsChangedCallback && receivedSettings != currentSettings) {
-                currentSettings = receivedSettings;
-                settingsChangedCallback();
-              } else {
-                currentSettings = receivedSettings;
-              }
-
-              // if this is the first time we have synced with the heatpump, set wantedSettings to receivedSettings
-              // hack: add grace period of a few seconds before respecting external changes
-              if(firstRun || (autoUpdate && externalUpdate && millis() - lastWanted > AUTOUPDATE_GRACE_PERIOD_IGNORE_EXTERNAL_UPDATES_MS)) {
-                wantedSettings = currentSettings;
-                firstRun = false;
-              }
-
-              return RCVD_PKT_SETTINGS;
+  return RCVD_PKT_FAIL;
+}
+
+// a packet from the unit with a valid checksum, data holds dataLength bytes and the checksum
+int HeatPump::decodePacket(byte* header, byte* data, int dataLength) {
+  lastRecv = millis();
+#if HEATPUMP_ENABLE_LINK_STATS
+  linkStats.packetsReceived++;
+#endif
+#if HEATPUMP_ENABLE_PACKET_CALLBACK
+  if(packetCallback) {
+    byte packet[37] = {}; // we are going to put header[5] and data[32] into this, so the whole packet is sent to the callback
+    for(int i=0; i<INFOHEADER_LEN; i++) {
+      packet[i] = header[i];
+    }
+    for(int i=0; i<(dataLength+1); i++) { //must be dataLength+1 to pick up checksum byte
+      packet[(i+5)] = data[i];
+    }
+    packetCallback(packet, PACKET_LEN, (char*)"packetRecv");
+  }
+#endif
+
+  if(header[1] == 0x62) {
+#if HEATPUMP_ENABLE_RESPONSE_HANDLERS
+    // user handlers see every response first, including the types the library does not decode (0x04, 0x09)
+    for(int i = 0; i < responseHandlerCount; i++) {
+      if(responseHandlers[i].type == data[0]) {
+        responseHandlers[i].responseCallback(data, dataLength);
+      }
+    }
+#endif
+
+    for(int i = 0; i < RESPONSE_DECODER_COUNT; i++) {
+      if(RESPONSE_DECODERS[i].type == data[0]) {
+        byte payload[RESPONSE_DATA_LEN] = {};
+        memcpy(payload, data, dataLength < RESPONSE_DATA_LEN ? dataLength : RESPONSE_DATA_LEN);
+
+#if HEATPUMP_ENABLE_WARM_START
+        // a restored payload has to be decoded again when the unit confirms it, it is no longer stale
+        bool stale = staleResponses & (1 << i);
+        staleResponses &= ~(1 << i);
+        if(!stale && memcmp(payload, responseData[i], RESPONSE_DATA_LEN) == 0) {
+#else
+        if(memcmp(payload, responseData[i], RESPONSE_DATA_LEN) == 0) {
+#endif
+          // most polls return exactly the previous payload, nothing can have changed
+          duplicateResponses++;
+          if(pendingDecode & (1 << i)) {
+            if(decodeNeeded(i)) {
+              decodeResponse(i);
             }
+          } else if(data[0] == 0x02) {
+            observeSettings(); // still an observation for reconcileWantedSettings() and sent fields
+          }
+          return RESPONSE_DECODERS[i].packetType;
+        }
+
+        // keep the payload, it is only decoded once a callback, autoUpdate or a getter needs it
+        memcpy(responseData[i], payload, RESPONSE_DATA_LEN);
+#if HEATPUMP_ENABLE_IDLE_MODE
+        lastActivity = millis();
+#endif
+        pendingDecode |= (1 << i);
+        if(decodeNeeded(i)) {
+          decodeResponse(i);
+        }
+        return RESPONSE_DECODERS[i].packetType;
+      }
+    }
 
-            case 0x03: { //Room temperature reading
-              heatpumpStatus receivedStatus;
+#if HEATPUMP_ENABLE_FUNCTIONS
+    if((data[0] == 0x20 || data[0] == 0x22) && decodeFunctions(data, dataLength)) {
+      return RCVD_PKT_FUNCTIONS;
+    }
+#endif
+  } 
+  
+  if(header[1] == 0x61) { //Last update was successful 
+    return RCVD_PKT_UPDATE_SUCCESS;
+  } else if(header[1] == 0x7a) { //Last update was successful 
+    connected = true;
+    return RCVD_PKT_CONNECT_SUCCESS;
+  }
 
-              if(data[6] != 0x00) {
-                int temp = data[6];
-                temp -= 128;
-                receivedStatus.roomTemperature = (float)temp / 2;
-              } else {
-                receivedStatus.roomTemperature = lookupByteMapValue(ROOM_TEMP_MAP, ROOM_TEMP, 32, data[3]);
-              }
+  return RCVD_PKT_FAIL;
+}
 
-              if((statusChangedCallback || roomTempChangedCallback) && currentStatus.roomTemperature != receivedStatus.roomTemperature) {
-                currentStatus.roomTemperature = receivedStatus.roomTemperature;
+// 0x62 response types decoded by the library, responseData and pendingDecode are indexed like this table
+const HeatPump::responseDecoder HeatPump::RESPONSE_DECODERS[RESPONSE_DECODER_COUNT] = {
+  {0x02, RCVD_PKT_SETTINGS,  &HeatPump::decodeSettings}, // setting information
+  {0x03, RCVD_PKT_ROOM_TEMP, &HeatPump::decodeRoomTemp}, // room temperature reading
+#if HEATPUMP_ENABLE_TIMERS
+  {0x05, RCVD_PKT_TIMER,     &HeatPump::decodeTimers},   // timer packet
+#endif
+  {0x06, RCVD_PKT_STATUS,    &HeatPump::decodeStatus}    // status
+};
 
-                if(statusChangedCallback) {
-                  statusChangedCallback(currentStatus);
-                }
+// a response of this type came from the unit since connecting, or was restored and has been confirmed since
+bool HeatPump::responseObserved(int decoder) {
+  if(responseData[decoder][0] != RESPONSE_DECODERS[decoder].type) {
+    return false;
+  }
+#if HEATPUMP_ENABLE_WARM_START
+  return !(staleResponses & (1 << decoder));
+#else
+  return true;
+#endif
+}
 
-                if(roomTempChangedCallback) { // this should be deprecated - statusChangedCallback covers it
-                  roomTempChangedCallback(currentStatus.roomTemperature);
-                }
-              } else {
-                currentStatus.roomTemperature = receivedStatus.roomTemperature;
-              }
+// part of the regular poll cycle
+bool HeatPump::isPolled(byte type) {
+  int last = fastSync ? 2 : INFOMODE_LEN - 1;
+  for(int i = 0; i <= last; i++) {
+    if(INFOMODE[i] == type) {
+      return true;
+    }
+  }
+  return false;
+}
 
-              return RCVD_PKT_ROOM_TEMP;
-            }
+bool HeatPump::decodeNeeded(int decoder) {
+  switch(RESPONSE_DECODERS[decoder].type) {
+    case 0x02:
+      // autoUpdate compares wanted and current settings, the first packet initialises wantedSettings
+      return settingsChangedCallback || autoUpdate || firstRun;
+    case 0x03:
+#if HEATPUMP_ENABLE_ROOM_TEMP_CALLBACK
+      return statusChangedCallback || roomTempChangedCallback;
+#else
+      return (bool)statusChangedCallback;
+#endif
+    case 0x06:
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+      return statusChangedCallback || runtimeStatsEnabled;
+#else
+      return (bool)statusChangedCallback;
+#endif
+    default:
+      return (bool)statusChangedCallback;
+  }
+}
 
-            case 0x04: { // unknown
-                break; 
-            }
+void HeatPump::decodeResponse(int decoder) {
+  pendingDecode &= ~(1 << decoder);
+  (this->*RESPONSE_DECODERS[decoder].decode)(responseData[decoder]);
+}
 
-            case 0x05: { // timer packet
-              heatpumpTimers receivedTimers;
+void HeatPump::decodePendingResponses() {
+  for(int i = 0; pendingDecode && i < RESPONSE_DECODER_COUNT; i++) {
+    if(pendingDecode & (1 << i)) {
+      decodeResponse(i);
+    }
+  }
+}
 
-              receivedTimers.mode                = lookupByteMapValue(TIMER_MODE_MAP, TIMER_MODE, 4, data[3]);
-              receivedTimers.onMinutesSet        = data[4] * TIMER_INCREMENT_MINUTES;
-              receivedTimers.onMinutesRemaining  = data[6] * TIMER_INCREMENT_MINUTES;
-              receivedTimers.offMinutesSet       = data[5] * TIMER_INCREMENT_MINUTES;
-              receivedTimers.offMinutesRemaining = data[7] * TIMER_INCREMENT_MINUTES;
+void HeatPump::decodeSettings(byte* data) {
+  heatpumpSettings receivedSettings {};
+  const byte modeOffset = SETTING_FIELDS[SETTING_MODE].getOffset;
+  receivedSettings.iSee = data[modeOffset] > MODE_ISEE ? true : false;
 
-              // callback for status change
-              if(statusChangedCallback && currentStatus.timers != receivedTimers) {
-                currentStatus.timers = receivedTimers;
-                statusChangedCallback(currentStatus);
-              } else {
-                currentStatus.timers = receivedTimers;
-              }
+  for(int i = 0; i < SETTING_FIELD_COUNT; i++) {
+    const wireField& field = SETTING_FIELDS[i];
+    byte raw = data[field.getOffset] & field.getMask;
+    if(i == SETTING_MODE && receivedSettings.iSee) {
+      raw -= MODE_ISEE;
+    }
+    receivedSettings.*field.setting = lookupWireValue(field.values, field.valueCount, raw)->name;
+  }
 
-              return RCVD_PKT_TIMER;
-            }
+  if(data[11] != 0x00) {
+    receivedSettings.temperature = halfDegreeFromWire(data[11]);
+    tempMode =  true;
+  } else {
+    receivedSettings.temperature = tempFromWire(data[5]);
+  }
+  wideVaneAdj = (data[SETTING_FIELDS[SETTING_WIDEVANE].getOffset] & 0xF0) == WIDEVANE_ADJ ? true : false;
+  
+  heatpumpSettings previousSettings = currentSettings;
+  if(settingsChangedCallback && receivedSettings != currentSettings) {
+    currentSettings = receivedSettings;
+    settingsChangedCallback();
+  } else {
+    currentSettings = receivedSettings;
+  }
 
-            case 0x06: { // status
-              heatpumpStatus receivedStatus;
-              receivedStatus.operating = data[4];
-              receivedStatus.compressorFrequency = data[3];
-
-              // callback for status change -- not triggered for compressor frequency at the moment
-              if(statusChangedCallback && currentStatus.operating != receivedStatus.operating) {
-                currentStatus.operating = receivedStatus.operating;
-                currentStatus.compressorFrequency = receivedStatus.compressorFrequency;
-                statusChangedCallback(currentStatus);
-              } else {
-                currentStatus.operating = receivedStatus.operating;
-                currentStatus.compressorFrequency = receivedStatus.compressorFrequency;
-              }
-
-              return RCVD_PKT_STATUS;
-            }
+  // if this is the first time we have synced with the heatpump, set wantedSettings to receivedSettings
+  if(firstRun) {
+    wantedSettings = currentSettings;
+    firstRun = false;
+  } else if(autoUpdate && externalUpdate) {
+    reconcileWantedSettings(previousSettings, currentSettings);
+  }
+  wantedSettings.iSee = currentSettings.iSee; // can not be set, never a reason to send an update
+  observeSettings();
+}
 
-            case 0x09: { // standby mode maybe?
-              break;
-            }
-            
-            case 0x20:
-            case 0x22: {
-              if (dataLength == 0x10) {
-                if (data[0] == 0x20) {
-                  functions.setData1(&data[1]);
-                } else {
-                  functions.setData2(&data[1]);
-                }
-                  
-                return RCVD_PKT_FUNCTIONS;
-              }
-              break;
-            }
-          } 
-        } 
-        
-        if(header[1] == 0x61) { //Last update was successful 
-          return RCVD_PKT_UPDATE_SUCCESS;
-        } else if(header[1] == 0x7a) { //Last update was successful 
-          connected = true;
-          return RCVD_PKT_CONNECT_SUCCESS;
-        }
-      }
+void HeatPump::decodeRoomTemp(byte* data) {
+  heatpumpStatus receivedStatus;
+
+  if(data[6] != 0x00) {
+    receivedStatus.roomTemperature = halfDegreeFromWire(data[6]);
+  } else {
+    receivedStatus.roomTemperature = roomTempFromWire(data[3]);
+  }
+
+  if(decodeNeeded(RESPONSE_DECODER_ROOM_TEMP) && currentStatus.roomTemperature != receivedStatus.roomTemperature) {
+    currentStatus.roomTemperature = receivedStatus.roomTemperature;
+
+    if(statusChangedCallback) {
+      statusChangedCallback(currentStatus);
+    }
+
+#if HEATPUMP_ENABLE_ROOM_TEMP_CALLBACK
+    if(roomTempChangedCallback) { // this should be deprecated - statusChangedCallback covers it
+      roomTempChangedCallback(currentStatus.roomTemperature);
     }
+#endif
+  } else {
+    currentStatus.roomTemperature = receivedStatus.roomTemperature;
   }
+}
 
-  return RCVD_PKT_FAIL;
+#if HEATPUMP_ENABLE_TIMERS
+void HeatPump::decodeTimers(byte* data) {
+  heatpumpTimers receivedTimers;
+
+  receivedTimers.mode                = lookupWireValue(TIMER_MODE_VALUES, 4, data[3])->name;
+  receivedTimers.onMinutesSet        = data[4] * TIMER_INCREMENT_MINUTES;
+  receivedTimers.onMinutesRemaining  = data[6] * TIMER_INCREMENT_MINUTES;
+  receivedTimers.offMinutesSet       = data[5] * TIMER_INCREMENT_MINUTES;
+  receivedTimers.offMinutesRemaining = data[7] * TIMER_INCREMENT_MINUTES;
+
+  // callback for status change
+  if(statusChangedCallback && currentStatus.timers != receivedTimers) {
+    currentStatus.timers = receivedTimers;
+    statusChangedCallback(currentStatus);
+  } else {
+    currentStatus.timers = receivedTimers;
+  }
 }
+#endif
+
+void HeatPump::decodeStatus(byte* data) {
+  heatpumpStatus receivedStatus;
+  receivedStatus.operating = data[4];
+  receivedStatus.compressorFrequency = data[3];
+
+  // callback for status change -- not triggered for compressor frequency at the moment
+  if(statusChangedCallback && currentStatus.operating != receivedStatus.operating) {
+    currentStatus.operating = receivedStatus.operating;
+    currentStatus.compressorFrequency = receivedStatus.compressorFrequency;
+    statusChangedCallback(currentStatus);
+  } else {
+    currentStatus.operating = receivedStatus.operating;
+    currentStatus.compressorFrequency = receivedStatus.compressorFrequency;
+  }
+}
+
+#if HEATPUMP_ENABLE_FUNCTIONS
+bool HeatPump::decodeFunctions(byte* data, int dataLength) {
+  if (dataLength == 0x10) {
+    bool fetching = functionsPending != 0;
+    if (data[0] == 0x20) {
+      functions.setData1(&data[1]);
+      functionsPending &= ~0x01;
+    } else {
+      functions.setData2(&data[1]);
+      functionsPending &= ~0x02;
+    }
+    functionsAttempts = 0;
+
+    // both halves of a requested fetch have arrived
+    if (fetching && !functionsPending && functions.isValid()) {
+      functionsCached = true;
+      functionsFetched = millis();
+      if (functionsCallback) {
+        functionsCallback(functions);
+      }
+    }
+      
+    return true;
+  }
+  return false;
+}
+#endif
 
 void HeatPump::readAllPackets() {
   while (_HardSerial->available() > 0) {
@@ -799,6 +1738,255 @@ void HeatPump::readAllPackets() {
   }
 }
 
+#if HEATPUMP_ENABLE_PROXY
+void HeatPump::beginBus(byte mode) {
+  busMode = mode;
+  // another controller does the connecting, we are connected once the unit answers it
+  connected = false;
+  unitFrame.length = 0;
+  controllerFrame.length = 0;
+  heldLength = 0;
+  // give the other controller a full interval to ask before a response type counts as stale
+  for(int i = 0; i < INFOMODE_LEN; i++) {
+    busSeen[i] = millis();
+  }
+  if(onConnectCallback) {
+    onConnectCallback();
+  }
+}
+
+void HeatPump::proxySync() {
+  unsigned long now = millis();
+
+  // controller to unit, held back while the unit answers a packet of ours
+  while(controllerSerial && controllerSerial->available() > 0) {
+    byte b = controllerSerial->read();
+    if(!waitForRead) {
+      _HardSerial->write(b);
+    } else if(heldLength < (int)sizeof(heldBytes)) {
+      heldBytes[heldLength++] = b;
+    }
+    if(pushFrameByte(controllerFrame, b, now)) {
+      if(frameValid(controllerFrame)) {
+        busRequest(controllerFrame, now);
+      }
+      controllerFrame.length = 0;
+    }
+  }
+
+  // unit to controller, except the answers to our own packets. In listen mode both directions arrive here
+  while(_HardSerial->available() > 0) {
+    byte b = _HardSerial->read();
+    bool ours = waitForRead;
+    if(controllerSerial && !ours) {
+      controllerSerial->write(b);
+    }
+    if(pushFrameByte(unitFrame, b, now)) {
+      if(frameValid(unitFrame)) {
+        // responses have bit 0x20 set in their type: 0x41/0x61, 0x42/0x62, 0x5a/0x7a
+        if(unitFrame.data[1] & 0x20) {
+          busResponse(unitFrame, ours, now);
+        } else if(!ours) {
+          busRequest(unitFrame, now); // while we wait for an answer, a request is our own echo
+        }
+      }
+      unitFrame.length = 0;
+    }
+  }
+
+  // no answer, give the bus back
+  if(waitForRead && now - lastSend > PACKET_SENT_INTERVAL_MS) {
+    waitForRead = false;
+    proxyUpdatePending = false; // autoUpdate tries again
+    unitFrame.length = 0;
+    releaseHeldBytes();
+  }
+  if(controllerWaiting && now - controllerRequest > PACKET_SENT_INTERVAL_MS) {
+    controllerWaiting = false;
+  }
+  if(connected && now - lastRecv > PACKET_SENT_INTERVAL_MS * 10) {
+#if HEATPUMP_ENABLE_LINK_STATS
+    linkStats.reconnects++;
+#endif
+    connected = false;
+  }
+
+  // our packets only go out when nothing is on the wire and nobody is waiting for an answer
+  if(!connected || waitForRead || controllerWaiting || unitFrame.length > 0 || controllerFrame.length > 0 ||
+     now - unitFrame.lastByte < PROXY_IDLE_MS || now - controllerFrame.lastByte < PROXY_IDLE_MS) {
+    return;
+  }
+  if(autoUpdate && !firstRun && !proxyUpdatePending && wantedSettings != currentSettings) {
+    update();
+  }
+  if(txQueueCount > 0) {
+    sendQueuedPacket();
+  } else {
+    pollStale(now);
+  }
+}
+
+void HeatPump::busRequest(busFrame& frame, unsigned long now) {
+  controllerWaiting = true;
+  controllerRequest = now;
+  // a settings packet of the controller's, applied once the unit acknowledges it
+  observedSetPending = frame.data[1] == 0x41 && frame.data[5] == 0x01;
+  if(observedSetPending) {
+    memcpy(observedSet, frame.data, PACKET_LEN);
+  }
+#if HEATPUMP_ENABLE_PACKET_CALLBACK
+  if(packetCallback) {
+    packetCallback(frame.data, frame.length, (char*)"packetSent");
+  }
+#endif
+}
+
+void HeatPump::busResponse(busFrame& frame, bool ours, unsigned long now) {
+  connected = true;
+  int packetType = decodePacket(frame.data, frame.data + INFOHEADER_LEN, frame.data[4]);
+  if(frame.data[1] == 0x62) {
+    for(int i = 0; i < INFOMODE_LEN; i++) {
+      if(INFOMODE[i] == frame.data[5]) {
+        busSeen[i] = now;
+      }
+    }
+  }
+  if(packetType == RCVD_PKT_SETTINGS) {
+    proxyUpdatePending = false;
+  }
+  if(!ours) {
+    if(packetType == RCVD_PKT_UPDATE_SUCCESS && observedSetPending) {
+      applyObservedSet();
+    }
+    observedSetPending = false;
+    controllerWaiting = false;
+    return;
+  }
+  waitForRead = false;
+  if(packetType == RCVD_PKT_UPDATE_SUCCESS && proxyUpdatePending) {
+    markWantedSent();
+    // read the new settings back instead of waiting for the controller to ask
+    byte packet[PACKET_LEN] = {};
+    createInfoPacket(packet, 0);
+    queuePacket(packet, PACKET_LEN, TX_CLASS_INFO);
+  }
+  releaseHeldBytes();
+}
+
+// the settings the unit just acknowledged to the controller, patched into the last settings response.
+// Decoded like a response, without waiting for the next poll to bring them
+void HeatPump::applyObservedSet() {
+  byte* settings = responseData[RESPONSE_DECODER_SETTINGS];
+  if(settings[0] != RESPONSE_DECODERS[RESPONSE_DECODER_SETTINGS].type) {
+    return; // nothing to patch yet, the next poll reports all of them
+  }
+  byte payload[RESPONSE_DATA_LEN];
+  memcpy(payload, settings, RESPONSE_DATA_LEN);
+
+  for(int i = 0; i < SETTING_FIELD_COUNT; i++) {
+    const wireField& field = SETTING_FIELDS[i];
+    if(!(observedSet[field.controlOffset] & field.controlFlag)) {
+      continue;
+    }
+    byte raw = observedSet[field.setOffset] & field.getMask;
+    if(i == SETTING_MODE && payload[field.getOffset] > MODE_ISEE) {
+      raw += MODE_ISEE;
+    }
+    payload[field.getOffset] = (payload[field.getOffset] & ~field.getMask) | raw;
+  }
+  if(observedSet[6] & CONTROL_TEMP) {
+    if(observedSet[19] != 0x00) {
+      payload[11] = observedSet[19];
+    } else if(payload[11] != 0x00) {
+      payload[11] = halfDegreeToWire(tempFromWire(observedSet[10]));
+    } else {
+      payload[5] = observedSet[10];
+    }
+  }
+
+  if(memcmp(payload, settings, RESPONSE_DATA_LEN) == 0) {
+    return;
+  }
+  memcpy(settings, payload, RESPONSE_DATA_LEN);
+#if HEATPUMP_ENABLE_IDLE_MODE
+  lastActivity = millis();
+#endif
+  pendingDecode |= (1 << RESPONSE_DECODER_SETTINGS);
+  if(decodeNeeded(RESPONSE_DECODER_SETTINGS)) {
+    decodeResponse(RESPONSE_DECODER_SETTINGS);
+  }
+}
+
+// polls the response type nobody has asked for the longest, if that is longer than staleInterval
+bool HeatPump::pollStale(unsigned long now) {
+  if(staleInterval == 0) {
+    return false;
+  }
+  // the same types the regular poll cycle would ask for
+  int last = fastSync ? 2 : INFOMODE_LEN - 1;
+  int stalest = -1;
+  for(int i = 0; i <= last; i++) {
+    if(now - busSeen[i] >= staleInterval && (stalest < 0 || now - busSeen[i] > now - busSeen[stalest])) {
+      stalest = i;
+    }
+  }
+  if(stalest < 0) {
+    return false;
+  }
+
+  byte packet[PACKET_LEN] = {};
+  createInfoPacket(packet, stalest);
+  busSeen[stalest] = now; // not again before the next interval, even without an answer
+  recordTx(TX_CLASS_INFO, now);
+#if HEATPUMP_ENABLE_LINK_STATS
+  countPoll(packet[5]);
+#endif
+  writePacket(packet, PACKET_LEN);
+  return true;
+}
+
+// adds a byte seen on the bus, true once the frame holds a whole packet
+bool HeatPump::pushFrameByte(busFrame& frame, byte b, unsigned long now) {
+  if(frame.length > 0 && now - frame.lastByte > FRAME_GAP_MS) {
+    frame.length = 0; // the rest of that packet never came
+  }
+  frame.lastByte = now;
+  if(frame.length == 0 && b != HEADER[0]) {
+    return false; // noise between packets
+  }
+  frame.data[frame.length++] = b;
+  if(frame.length == INFOHEADER_LEN &&
+     (frame.data[2] != HEADER[2] || frame.data[3] != HEADER[3] || frame.data[4] > PACKET_LEN - INFOHEADER_LEN - 1)) {
+#if HEATPUMP_ENABLE_LINK_STATS
+    linkStats.headerErrors++;
+#endif
+    frame.length = 0;
+    return false;
+  }
+  return frame.length > INFOHEADER_LEN && frame.length == frame.data[4] + INFOHEADER_LEN + 1;
+}
+
+bool HeatPump::frameValid(busFrame& frame) {
+  if(checkSum(frame.data, frame.length - 1) == frame.data[frame.length - 1]) {
+    return true;
+  }
+#if HEATPUMP_ENABLE_LINK_STATS
+  linkStats.checksumErrors++;
+#endif
+  return false;
+}
+
+void HeatPump::releaseHeldBytes() {
+  if(heldLength > 0 && controllerWaiting) {
+    controllerRequest = millis(); // the unit only sees the request now
+  }
+  for(int i = 0; i < heldLength; i++) {
+    _HardSerial->write(heldBytes[i]);
+  }
+  heldLength = 0;
+}
+#endif
+
 void HeatPump::prepareInfoPacket(byte* packet, int length) {
   memset(packet, 0, length * sizeof(byte));
   
@@ -815,19 +2003,26 @@ void HeatPump::prepareSetPacket(byte* packet, int length) {
   }  
 }
 
+#if HEATPUMP_ENABLE_FUNCTIONS
 heatpumpFunctions HeatPump::getFunctions() {
+  if (functionsCacheFresh()) {
+    return functions;
+  }
+#if HEATPUMP_ENABLE_PROXY
+  if (busMode != BUS_DIRECT) {
+    return heatpumpFunctions(); // the installer codes are only read on a bus of our own
+  }
+#endif
+
+  byte requested = functionsPending;
   functions.clear();
+  functionsPending = 0x03;
   
   byte packet1[PACKET_LEN] = {};
   byte packet2[PACKET_LEN] = {};
 
-  prepareInfoPacket(packet1, PACKET_LEN);
-  packet1[5] = FUNCTIONS_GET_PART1;
-  packet1[21] = checkSum(packet1, 21);
-
-  prepareInfoPacket(packet2, PACKET_LEN);
-  packet2[5] = FUNCTIONS_GET_PART2;
-  packet2[21] = checkSum(packet2, 21);
+  createFunctionsInfoPacket(packet1, FUNCTIONS_GET_PART1);
+  createFunctionsInfoPacket(packet2, FUNCTIONS_GET_PART2);
   
   while(!canSend(false)) { delay(10); }
   writePacket(packet1, PACKET_LEN);
@@ -844,48 +2039,151 @@ heatpumpFunctions HeatPump::getFunctions() {
     readPacket();
   }
 
+  // a failed fetch is not retried by sync(), unless requestFunctions() was waiting for one
+  if (!functions.isValid()) {
+    functionsPending = requested ? 0x03 : 0;
+  }
   return functions;
 }
 
+void HeatPump::requestFunctions() {
+  if (functionsCacheFresh()) {
+    if (functionsCallback) {
+      functionsCallback(functions);
+    }
+    return;
+  }
+#if HEATPUMP_ENABLE_PROXY
+  if (busMode != BUS_DIRECT) {
+    if (functionsCallback) {
+      functionsCallback(heatpumpFunctions());
+    }
+    return;
+  }
+#endif
+
+  if (!functionsPending) {
+    functions.clear();
+    functionsPending = 0x03;
+    functionsPolls = 0;
+    functionsAttempts = 0;
+  }
+}
+
+// an outstanding requestFunctions() takes the place of every FUNCTIONS_POLL_EVERY-th regular info poll
+bool HeatPump::createPendingFunctionsPacket(byte *packet) {
+  if (!functionsPending || ++functionsPolls < FUNCTIONS_POLL_EVERY) {
+    return false;
+  }
+  functionsPolls = 0;
+  if (functionsAttempts >= FUNCTIONS_MAX_ATTEMPTS) {
+    // the unit does not answer, give up and let the callback know
+    functionsPending = 0;
+    functionsAttempts = 0;
+    functions.clear();
+    if (functionsCallback) {
+      functionsCallback(functions);
+    }
+    return false;
+  }
+  functionsAttempts++;
+  createFunctionsInfoPacket(packet, (functionsPending & 0x01) ? FUNCTIONS_GET_PART1 : FUNCTIONS_GET_PART2);
+  return true;
+}
+
+void HeatPump::setFunctionsCacheTTL(unsigned long ttlMs) {
+  functionsCacheTTL = ttlMs;
+}
+
+bool HeatPump::functionsCacheFresh() {
+  return functionsCached && millis() - functionsFetched < functionsCacheTTL;
+}
+
 bool HeatPump::setFunctions(heatpumpFunctions const& functions) {
   if (!functions.isValid()) {
     return false;
   }
+#if HEATPUMP_ENABLE_PROXY
+  if (busMode != BUS_DIRECT) {
+    return false;
+  }
+#endif
 
-  byte packet1[PACKET_LEN] = {};
-  byte packet2[PACKET_LEN] = {};
+  // the unit is about to change, the next getFunctions()/requestFunctions() has to fetch again
+  functionsCached = false;
 
-  prepareSetPacket(packet1, PACKET_LEN);
-  packet1[5] = FUNCTIONS_SET_PART1;
-  
-  prepareSetPacket(packet2, PACKET_LEN);
-  packet2[5] = FUNCTIONS_SET_PART2;
-  
-  functions.getData1(&packet1[6]);
-  functions.getData2(&packet2[6]);
+  // only the half that actually changed is written, and verified by reading back just that half
+  if (functions.isDirty1() && !writeFunctionsPart(functions, FUNCTIONS_SET_PART1, FUNCTIONS_GET_PART1)) {
+    return false;
+  }
+  if (functions.isDirty2() && !writeFunctionsPart(functions, FUNCTIONS_SET_PART2, FUNCTIONS_GET_PART2)) {
+    return false;
+  }
+
+  return true;
+}
+
+bool HeatPump::writeFunctionsPart(heatpumpFunctions const& functions, byte setPart, byte getPart) {
+  byte packet[PACKET_LEN] = {};
+
+  prepareSetPacket(packet, PACKET_LEN);
+  packet[5] = setPart;
+
+  if (setPart == FUNCTIONS_SET_PART1) {
+    functions.getData1(&packet[6]);
+  } else {
+    functions.getData2(&packet[6]);
+  }
 
   // sanity check, we expect data byte 15 (index 20) to be 0
-  if (packet1[20] != 0 || packet2[20] != 0)
+  if (packet[20] != 0)
     return false;
-    
+
   // make sure all the other data bytes are set
   for (int i = 6; i < 20; ++i) {
-    if (packet1[i] == 0 || packet2[i] == 0)
+    if (packet[i] == 0)
       return false;
   }
 
-  packet1[21] = checkSum(packet1, 21);
-  packet2[21] = checkSum(packet2, 21);
+  packet[21] = checkSum(packet, 21);
 
   while(!canSend(false)) { delay(10); }
-  writePacket(packet1, PACKET_LEN);
-  readPacket();
+  // flush any responses to earlier requests so the next packet read is our ack
+  readAllPackets();
+  writePacket(packet, PACKET_LEN);
+  while(!canRead()) { delay(10); }
+  if (readPacket() != RCVD_PKT_UPDATE_SUCCESS) {
+    return false;
+  }
+
+  // read back the half we just wrote
+  byte expected[15];
+  byte actual[15];
+  memcpy(expected, &packet[6], 15);
+
+  createFunctionsInfoPacket(packet, getPart);
 
   while(!canSend(false)) { delay(10); }
-  writePacket(packet2, PACKET_LEN);
-  readPacket();
+  writePacket(packet, PACKET_LEN);
+  while(!canRead()) { delay(10); }
 
-  return true;
+  // retry reading a few times in case responses were related
+  // to other requests
+  int packetType = readPacket();
+  for (int i = 0; i < 5 && packetType != RCVD_PKT_FUNCTIONS; ++i) {
+    delay(100);
+    packetType = readPacket();
+  }
+  if (packetType != RCVD_PKT_FUNCTIONS) {
+    return false;
+  }
+
+  if (getPart == FUNCTIONS_GET_PART1) {
+    this->functions.getData1(actual);
+  } else {
+    this->functions.getData2(actual);
+  }
+  return memcmp(expected, actual, 15) == 0;
 }
 
 
@@ -897,14 +2195,42 @@ bool heatpumpFunctions::isValid() const {
   return _isValid1 && _isValid2;
 }
 
+bool heatpumpFunctions::isDirty1() const {
+  return _isDirty1;
+}
+
+bool heatpumpFunctions::isDirty2() const {
+  return _isDirty2;
+}
+
 void heatpumpFunctions::setData1(byte* data) {
   memcpy(raw, data, 15);
   _isValid1 = true;
+  _isDirty1 = false;
+  buildIndex(0);
 }
 
 void heatpumpFunctions::setData2(byte* data) {
   memcpy(raw + 15, data, 15);
   _isValid2 = true;
+  _isDirty2 = false;
+  buildIndex(15);
+}
+
+void heatpumpFunctions::buildIndex(int offset) {
+  // forget codes previously found in this half, then record where each code lives
+  for (int i = 0; i < FUNCTION_CODE_LAST - FUNCTION_CODE_FIRST + 1; ++i) {
+    if (index[i] != NO_INDEX && index[i] >= offset && index[i] < offset + 15) {
+      index[i] = NO_INDEX;
+    }
+  }
+
+  for (int i = offset; i < offset + 15; ++i) {
+    int code = getCode(raw[i]);
+    if (code >= FUNCTION_CODE_FIRST && code <= FUNCTION_CODE_LAST) {
+      index[code - FUNCTION_CODE_FIRST] = i;
+    }
+  }
 }
 
 void heatpumpFunctions::getData1(byte* data) const {
@@ -917,8 +2243,11 @@ void heatpumpFunctions::getData2(byte* data) const {
 
 void heatpumpFunctions::clear() {
   memset(raw, 0, sizeof(raw));
+  memset(index, NO_INDEX, sizeof(index));
   _isValid1 = false;
   _isValid2 = false;
+  _isDirty1 = false;
+  _isDirty2 = false;
 }
 
 int heatpumpFunctions::getCode(byte b) {
@@ -930,32 +2259,37 @@ int heatpumpFunctions::getValue(byte b) {
 }
     
 int heatpumpFunctions::getValue(int code) {
-  if (code > 128 || code < 101)
+  if (code > FUNCTION_CODE_LAST || code < FUNCTION_CODE_FIRST)
+    return 0;
+
+  byte i = index[code - FUNCTION_CODE_FIRST];
+  if (i == NO_INDEX)
     return 0;
-    
-  for (int i = 0; i < MAX_FUNCTION_CODE_COUNT; ++i) {
-    if (getCode(raw[i]) == code)
-      return getValue(raw[i]);
-  }
 
-  return 0;
+  return getValue(raw[i]);
 }
 
 bool heatpumpFunctions::setValue(int code, int value) {
-  if (code > 128 || code < 101)
+  if (code > FUNCTION_CODE_LAST || code < FUNCTION_CODE_FIRST)
     return false;
 
   if (value < 1 || value > 3)
     return false;
-    
-  for (int i = 0; i < MAX_FUNCTION_CODE_COUNT; ++i) {
-    if (getCode(raw[i]) == code) {
-      raw[i] = ((code - 100) << 2) + value;
-      return true;
+
+  byte i = index[code - FUNCTION_CODE_FIRST];
+  if (i == NO_INDEX)
+    return false;
+
+  byte b = ((code - 100) << 2) + value;
+  if (raw[i] != b) {
+    raw[i] = b;
+    if (i < 15) {
+      _isDirty1 = true;
+    } else {
+      _isDirty2 = true;
     }
   }
-
-  return false;
+  return true;
 }
 
 heatpumpFunctionCodes heatpumpFunctions::getAllCodes() {
@@ -970,9 +2304,10 @@ heatpumpFunctionCodes heatpumpFunctions::getAllCodes() {
 }
 
 bool heatpumpFunctions::operator==(const heatpumpFunctions& rhs) {
-  return this->isValid() == rhs.isValid() && memcmp(this->raw, rhs.raw, MAX_FUNCTION_CODE_COUNT * sizeof(int)) == 0;
+  return this->isValid() == rhs.isValid() && memcmp(this->raw, rhs.raw, sizeof(raw)) == 0;
 }
 
 bool heatpumpFunctions::operator!=(const heatpumpFunctions& rhs) {
   return !(*this==rhs);
 }
+#endif
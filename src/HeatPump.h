@@ -23,25 +23,22 @@
 #else
 #include "WProgram.h"
 #endif
+#include "HeatPumpConfig.h"
 
 /* 
- * Callback function definitions. Code differs for the ESP8266 platform, which requires the functional library.
+ * Callback function definitions. heatpumpDelegate accepts plain functions as well as lambdas with small
+ * captures on every platform, without the heap allocations std::function can make.
  * Based on callback implementation in the Arduino Client for MQTT library (https://github.com/knolleary/pubsubclient)
  */
-#if defined(ESP8266) || defined(ESP32)
-#include <functional>
-#define ON_CONNECT_CALLBACK_SIGNATURE std::function<void()> onConnectCallback
-#define SETTINGS_CHANGED_CALLBACK_SIGNATURE std::function<void()> settingsChangedCallback
-#define STATUS_CHANGED_CALLBACK_SIGNATURE std::function<void(heatpumpStatus newStatus)> statusChangedCallback
-#define PACKET_CALLBACK_SIGNATURE std::function<void(byte* packet, unsigned int length, char* packetDirection)> packetCallback
-#define ROOM_TEMP_CHANGED_CALLBACK_SIGNATURE std::function<void(float currentRoomTemperature)> roomTempChangedCallback
-#else
-#define ON_CONNECT_CALLBACK_SIGNATURE void (*onConnectCallback)()
-#define SETTINGS_CHANGED_CALLBACK_SIGNATURE void (*settingsChangedCallback)()
-#define STATUS_CHANGED_CALLBACK_SIGNATURE void (*statusChangedCallback)(heatpumpStatus newStatus)
-#define PACKET_CALLBACK_SIGNATURE void (*packetCallback)(byte* packet, unsigned int length, char* packetDirection)
-#define ROOM_TEMP_CHANGED_CALLBACK_SIGNATURE void (*roomTempChangedCallback)(float currentRoomTemperature)
-#endif
+#include "HeatPumpDelegate.h"
+#define ON_CONNECT_CALLBACK_SIGNATURE heatpumpDelegate<void()> onConnectCallback
+#define SETTINGS_CHANGED_CALLBACK_SIGNATURE heatpumpDelegate<void()> settingsChangedCallback
+#define STATUS_CHANGED_CALLBACK_SIGNATURE heatpumpDelegate<void(heatpumpStatus newStatus)> statusChangedCallback
+#define PACKET_CALLBACK_SIGNATURE heatpumpDelegate<void(byte* packet, unsigned int length, char* packetDirection)> packetCallback
+#define ROOM_TEMP_CHANGED_CALLBACK_SIGNATURE heatpumpDelegate<void(float currentRoomTemperature)> roomTempChangedCallback
+#define FUNCTIONS_CALLBACK_SIGNATURE heatpumpDelegate<void(heatpumpFunctions functions)> functionsCallback
+#define RESPONSE_CALLBACK_SIGNATURE heatpumpDelegate<void(byte* data, unsigned int length)> responseCallback
+#define RUNTIME_STATS_CALLBACK_SIGNATURE heatpumpDelegate<void(heatpumpRuntimeStats stats)> runtimeStatsCallback
 
 typedef uint8_t byte;
 
@@ -77,6 +74,46 @@ struct heatpumpStatus {
   int compressorFrequency;
 };
 
+bool operator==(const heatpumpStatus& lhs, const heatpumpStatus& rhs);
+bool operator!=(const heatpumpStatus& lhs, const heatpumpStatus& rhs);
+
+// running totals computed from the decoded status, see HeatPump::getRuntimeStats()
+struct heatpumpRuntimeStats {
+  unsigned long observedSeconds;  // time the status was known (connected)
+  unsigned long operatingSeconds; // time the heat pump was operating
+  unsigned long cycles;           // times operating switched on
+  unsigned long shortCycles;      // operating periods shorter than the short cycle threshold
+  unsigned long frequencySeconds; // compressor frequency integrated over the operating time (Hz * s)
+  unsigned long energyWh;         // estimated from the power model
+};
+
+// per priority class transmit statistics, see HeatPump::getTxStats()
+struct heatpumpTxStats {
+  unsigned long sent;        // packets written for this class
+  unsigned long totalWaitMs; // sum of the time packets spent waiting for a bus slot
+  unsigned long maxWaitMs;   // longest time a packet waited for a bus slot
+};
+
+#if HEATPUMP_ENABLE_LINK_STATS
+// info polls counted per request type: the INFOMODE codes in their order, then function code requests
+#define HEATPUMP_POLL_TYPES 7
+
+// protocol counters, see HeatPump::getLinkStats()
+struct heatpumpLinkStats {
+  unsigned long connects;        // CONNECT packets sent, one per bitrate tried
+  unsigned long reconnects;      // connects because a link that was up went quiet
+  unsigned long packetsReceived; // packets with a valid checksum
+  unsigned long checksumErrors;  // packets dropped for a bad checksum
+  unsigned long headerErrors;    // start byte seen, but not followed by a valid header
+  unsigned long lastRttMs;       // from the last packet sent to the start of its response
+  unsigned long maxRttMs;
+  unsigned long totalRttMs;      // divided by rttSamples, the average round trip
+  unsigned long rttSamples;
+  unsigned long polls[HEATPUMP_POLL_TYPES];
+};
+#endif
+
+#if HEATPUMP_ENABLE_FUNCTIONS
 #define MAX_FUNCTION_CODE_COUNT 30
 
 struct heatpumpFunctionCodes {
@@ -86,17 +123,29 @@ struct heatpumpFunctionCodes {
 
 class heatpumpFunctions  {
   private:
+    static const int FUNCTION_CODE_FIRST = 101;
+    static const int FUNCTION_CODE_LAST  = 128;
+    static const byte NO_INDEX = 0xff;
+
     byte raw[MAX_FUNCTION_CODE_COUNT];
+    // position of each code (101-128) in raw, NO_INDEX if the unit did not report it
+    byte index[FUNCTION_CODE_LAST - FUNCTION_CODE_FIRST + 1];
     bool _isValid1;
     bool _isValid2;
+    bool _isDirty1;
+    bool _isDirty2;
 
     int getCode(byte b);
     int getValue(byte b);
+    void buildIndex(int offset);
 
   public:
     heatpumpFunctions();
 
     bool isValid() const;
+    // true if setValue() changed a code in the first (codes sent with 0x1F) or second (0x21) half
+    bool isDirty1() const;
+    bool isDirty2() const;
     
     // data must be 15 bytes
     void setData1(byte* data);
@@ -114,6 +163,36 @@ class heatpumpFunctions  {
     bool operator==(const heatpumpFunctions& rhs);
     bool operator!=(const heatpumpFunctions& rhs);
 };
+#endif
+
+#if HEATPUMP_ENABLE_CHANGE_LOG
+// one entry of the change log, see HeatPump::getChanges()
+struct heatpumpChange {
+  unsigned long sequence;
+  byte field;       // HeatPump::CHANGE_*
+  const char* text; // new value of power, mode, fan, vane, wideVane and timer mode, otherwise nullptr
+  float value;      // new value of the numeric fields, 1/0 for operating and connected
+};
+#endif
+
+#if HEATPUMP_ENABLE_SNAPSHOTS
+// consistent copy of the decoded state, see HeatPump::getSnapshot()
+struct heatpumpSnapshot {
+  unsigned long version; // increases by one every time something in the snapshot changed
+  bool connected;
+  heatpumpSettings settings;
+  heatpumpSettings wantedSettings;
+  heatpumpStatus status;
+#if HEATPUMP_ENABLE_FUNCTIONS
+  bool functionsValid; // false until the function codes have been fetched
+  heatpumpFunctions functions;
+#endif
+};
+#endif
+
+#if HEATPUMP_ENABLE_HISTORY
+class HeatPumpHistory;
+#endif
 
 class HeatPump
 {
@@ -122,19 +201,36 @@ class HeatPump
     static const int PACKET_SENT_INTERVAL_MS = 1000;
     static const int PACKET_INFO_INTERVAL_MS = 2000;
     static const int PACKET_TYPE_DEFAULT = 99;
-    static const int AUTOUPDATE_GRACE_PERIOD_IGNORE_EXTERNAL_UPDATES_MS = 30000;
+    static const unsigned long FUNCTIONS_CACHE_TTL_MS = 600000UL;
+    static const byte FUNCTIONS_POLL_EVERY = 2;   // every second info poll asks for a requested functions part
+    static const byte FUNCTIONS_MAX_ATTEMPTS = 3; // requests without an answer before requestFunctions() gives up
 
     static const int CONNECT_LEN = 8;
-    const byte CONNECT[CONNECT_LEN] = {0xfc, 0x5a, 0x01, 0x30, 0x02, 0xca, 0x01, 0xa8};
+    static constexpr byte CONNECT[CONNECT_LEN] = {0xfc, 0x5a, 0x01, 0x30, 0x02, 0xca, 0x01, 0xa8};
     static const int HEADER_LEN  = 8;
-    const byte HEADER[HEADER_LEN]  = {0xfc, 0x41, 0x01, 0x30, 0x10, 0x01, 0x00, 0x00};
+    static constexpr byte HEADER[HEADER_LEN]  = {0xfc, 0x41, 0x01, 0x30, 0x10, 0x01, 0x00, 0x00};
+
+    // transmit queue for packets that do not need to wait for their response (remote temp, custom packets)
+    static const int TX_QUEUE_LEN = 4;
+    struct txPacket {
+      byte data[PACKET_LEN];
+      byte length;
+      byte txClass;
+      unsigned long queued;
+    };
 
     static const int INFOHEADER_LEN  = 5;
-    const byte INFOHEADER[INFOHEADER_LEN]  = {0xfc, 0x42, 0x01, 0x30, 0x10};
+    static constexpr byte INFOHEADER[INFOHEADER_LEN]  = {0xfc, 0x42, 0x01, 0x30, 0x10};
+
+    // sum of constant bytes, computed at compile time, so packet checksums only add the variable bytes
+    static constexpr int sumBytes(const byte* bytes, int len) {
+      return len == 0 ? 0 : bytes[len - 1] + sumBytes(bytes, len - 1);
+    }
+    static const int INFOHEADER_SUM;
     
  
     static const int INFOMODE_LEN = 6;
-    const byte INFOMODE[INFOMODE_LEN] = {
+    static constexpr byte INFOMODE[INFOMODE_LEN] = {
       0x02, // request a settings packet - RQST_PKT_SETTINGS
       0x03, // request the current room temp - RQST_PKT_ROOM_TEMP
       0x06, // request status - RQST_PKT_STATUS
@@ -143,40 +239,80 @@ class HeatPump
       0x09  // request standby mode (maybe?) RQST_PKT_STANDBY
     };
 
-    const int RCVD_PKT_FAIL            = 0;
-    const int RCVD_PKT_CONNECT_SUCCESS = 1;
-    const int RCVD_PKT_SETTINGS        = 2;
-    const int RCVD_PKT_ROOM_TEMP       = 3;
-    const int RCVD_PKT_UPDATE_SUCCESS  = 4;
-    const int RCVD_PKT_STATUS          = 5;
-    const int RCVD_PKT_TIMER           = 6;
-    const int RCVD_PKT_FUNCTIONS       = 7;
-
-    const byte CONTROL_PACKET_1[5] = {0x01,    0x02,  0x04,  0x08, 0x10};
-                                   //{"POWER","MODE","TEMP","FAN","VANE"};
-    const byte CONTROL_PACKET_2[1] = {0x01};
-                                   //{"WIDEVANE"};
-    const byte POWER[2]            = {0x00, 0x01};
-    const char* POWER_MAP[2]       = {"OFF", "ON"};
-    const byte MODE[5]             = {0x01,   0x02,  0x03, 0x07, 0x08};
-    const char* MODE_MAP[5]        = {"HEAT", "DRY", "COOL", "FAN", "AUTO"};
-    const byte TEMP[16]            = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
-    const int TEMP_MAP[16]         = {31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16};
-    const byte FAN[6]              = {0x00,  0x01,   0x02, 0x03, 0x05, 0x06};
-    const char* FAN_MAP[6]         = {"AUTO", "QUIET", "1", "2", "3", "4"};
-    const byte VANE[7]             = {0x00,  0x01, 0x02, 0x03, 0x04, 0x05, 0x07};
-    const char* VANE_MAP[7]        = {"AUTO", "1", "2", "3", "4", "5", "SWING"};
-    const byte WIDEVANE[7]         = {0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x0c};
-    const char* WIDEVANE_MAP[7]    = {"<<", "<",  "|",  ">",  ">>", "<>", "SWING"};
-    const byte ROOM_TEMP[32]       = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
-                                      0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
-    const int ROOM_TEMP_MAP[32]    = {10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
-                                      26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41};
-    const byte TIMER_MODE[4]       = {0x00,  0x01,  0x02, 0x03};
-    const char* TIMER_MODE_MAP[4]  = {"NONE", "OFF", "ON", "BOTH"};
+    static const int RCVD_PKT_FAIL            = 0;
+    static const int RCVD_PKT_CONNECT_SUCCESS = 1;
+    static const int RCVD_PKT_SETTINGS        = 2;
+    static const int RCVD_PKT_ROOM_TEMP       = 3;
+    static const int RCVD_PKT_UPDATE_SUCCESS  = 4;
+    static const int RCVD_PKT_STATUS          = 5;
+    static const int RCVD_PKT_TIMER           = 6;
+    static const int RCVD_PKT_FUNCTIONS       = 7;
+
+    // Wire schema. Every enumerated setting is described once: where it goes in the 0x41 set packet
+    // (and which control flag announces it), where it is found in the 0x62 settings response, and how
+    // its raw values map to names. createPacket() and decodeSettings() are both driven by SETTING_FIELDS.
+    struct wireValue {
+      byte raw;
+      const char* name;
+    };
+    struct wireField {
+      const char* heatpumpSettings::*setting;
+      byte setOffset;     // byte in the set packet
+      byte controlOffset; // control byte in the set packet (6 or 7)
+      byte controlFlag;   // bit set in the control byte when this field is sent
+      byte getOffset;     // byte in the settings response data
+      byte getMask;       // bits of that byte carrying the value
+      const wireValue* values;
+      byte valueCount;    // values[0] is used when a raw value or name is unknown
+    };
+
+    // indexes into SETTING_FIELDS, SETTING_TEMPERATURE is numeric and encoded separately
+    static const int SETTING_POWER       = 0;
+    static const int SETTING_MODE        = 1;
+    static const int SETTING_FAN         = 2;
+    static const int SETTING_VANE        = 3;
+    static const int SETTING_WIDEVANE    = 4;
+    static const int SETTING_FIELD_COUNT = 5;
+    static const int SETTING_TEMPERATURE = 5;
+
+    static const byte CONTROL_TEMP      = 0x04; // control byte 6
+    static const byte MODE_ISEE         = 0x08; // added to the mode byte when the iSee sensor is present
+    static const byte WIDEVANE_ADJ      = 0x80;
+
+    static const wireValue POWER_VALUES[2];
+    static const wireValue MODE_VALUES[5];
+    static const wireValue FAN_VALUES[6];
+    static const wireValue VANE_VALUES[7];
+    static const wireValue WIDEVANE_VALUES[7];
+    static const wireValue TIMER_MODE_VALUES[4];
+    static const wireField SETTING_FIELDS[SETTING_FIELD_COUNT];
+
+    // temperatures without half degree support are a fixed offset from the raw value
+    static constexpr int tempFromWire(byte raw) { return raw < 16 ? 31 - raw : 31; }
+    static constexpr byte tempToWire(int temp) { return 31 - temp; }
+    static constexpr int roomTempFromWire(byte raw) { return raw < 32 ? raw + 10 : 10; }
+    // half degree temperatures: raw = temp * 2 + 128
+    static constexpr float halfDegreeFromWire(byte raw) { return (float)(raw - 128) / 2; }
+    static constexpr byte halfDegreeToWire(float temp) { return (byte)(int)(temp * 2 + 128); }
 
     static const int TIMER_INCREMENT_MINUTES = 10;
 
+    // dispatch table for 0x62 responses, see RESPONSE_DECODERS in HeatPump.cpp
+    struct responseDecoder {
+      byte type;
+      int packetType; // RCVD_PKT_* returned by readPacket()
+      void (HeatPump::*decode)(byte* data);
+    };
+    static const int RESPONSE_DECODER_COUNT = HEATPUMP_ENABLE_TIMERS ? 4 : 3;
+    static const int RESPONSE_DECODER_SETTINGS = 0;
+    static const int RESPONSE_DECODER_ROOM_TEMP = 1;
+    static const int RESPONSE_DECODER_STATUS = RESPONSE_DECODER_COUNT - 1;
+    static const int RESPONSE_DATA_LEN = 16;
+    static const responseDecoder RESPONSE_DECODERS[RESPONSE_DECODER_COUNT];
+    byte responseData[RESPONSE_DECODER_COUNT][RESPONSE_DATA_LEN] {}; // last payload of each type
+    byte pendingDecode = 0; // bit per decoder, set while responseData has not been decoded yet
+    unsigned long duplicateResponses = 0; // responses identical to the previous one of their type, never decoded
+
     const byte FUNCTIONS_SET_PART1 = 0x1F;
     const byte FUNCTIONS_GET_PART1 = 0x20;
     const byte FUNCTIONS_SET_PART2 = 0x21;
@@ -187,11 +323,41 @@ class HeatPump
     heatpumpSettings wantedSettings {};
     // Hacks
     unsigned long lastWanted;
+    // when each wanted field was last set locally, and when the previous settings packet was decoded,
+    // used to reconcile external changes with enableExternalUpdate(). Counted in local writes rather than
+    // millis(), so the order still holds after the clock wraps
+    unsigned long settingsEvents = 0;
+    unsigned long wantedChanged[SETTING_FIELD_COUNT + 1] {}; // indexed by SETTING_*
+    unsigned long settingsObserved = 0;
+    // settings polls since a local write was acknowledged that still showed the old value, 0 when none is
+    // waiting. A unit can acknowledge a value it does not support and keep its own, after WANTED_MAX_POLLS
+    // such polls the field takes the unit's value, so autoUpdate stops sending it
+    static const byte WANTED_MAX_POLLS = 2;
+    byte wantedPolls[SETTING_FIELD_COUNT + 1] {};
 
     // initialise to all off, then it will update shortly after connect;
-    heatpumpStatus currentStatus {0, false, {TIMER_MODE_MAP[0], 0, 0, 0, 0}, 0};
+    heatpumpStatus currentStatus {0, false, {TIMER_MODE_VALUES[0].name, 0, 0, 0, 0}, 0};
 
+#if HEATPUMP_ENABLE_FUNCTIONS
     heatpumpFunctions functions;
+    // function codes rarely change, so they are cached and only re-fetched after functionsCacheTTL
+    bool functionsCached = false;
+    unsigned long functionsFetched = 0;
+    unsigned long functionsCacheTTL = FUNCTIONS_CACHE_TTL_MS;
+    byte functionsPending = 0; // bit 0: part 1 outstanding, bit 1: part 2 outstanding
+    byte functionsPolls = 0;    // info polls since the last functions request
+    byte functionsAttempts = 0; // functions requests since the last part arrived
+#endif
+
+    txPacket txQueue[TX_QUEUE_LEN];
+    int txQueueCount = 0;
+    unsigned long infoDue = 0; // when the next info poll became due, 0 if not due yet
+    heatpumpTxStats txStats[4] {}; // one per TX_CLASS_*
+#if HEATPUMP_ENABLE_LINK_STATS
+    heatpumpLinkStats linkStats {};
+    unsigned long responseStarted = 0; // when sync() first saw bytes of the awaited response, 0 if not yet
+    void countPoll(byte code);
+#endif
   
     HardwareSerial * _HardSerial {nullptr};
     int rxPin; // save rx pin for retry ESP32
@@ -207,20 +373,49 @@ class HeatPump
     bool externalUpdate;
     bool wideVaneAdj;
     bool fastSync = false;
+    int linkBitrate = 0; // the bitrate of the last successful connect, tried first on reconnect
+    unsigned long pollInterval = PACKET_INFO_INTERVAL_MS; // interval of the last info poll
+
+    const wireValue* lookupWireValue(const wireValue values[], int len, byte raw);
+    const wireValue* lookupWireName(const wireValue values[], int len, const char* name);
 
-    const char* lookupByteMapValue(const char* valuesMap[], const byte byteMap[], int len, byte byteValue);
-    int    lookupByteMapValue(const int valuesMap[], const byte byteMap[], int len, byte byteValue);
-    int    lookupByteMapIndex(const char* valuesMap[], int len, const char* lookupValue);
-    int    lookupByteMapIndex(const int valuesMap[], int len, int lookupValue);
+    void markWanted(int field);
+    void reconcileWantedSettings(const heatpumpSettings& previous, const heatpumpSettings& received);
+    bool wantedDiffers(int field);
+    void markWantedSent();
+    void observeSettings();
 
     bool canSend(bool isInfo);
+    unsigned long infoInterval();
     bool canRead();
     byte checkSum(byte bytes[], int len);
     void createPacket(byte *packet, heatpumpSettings settings);
     void createInfoPacket(byte *packet, byte packetType);
+#if HEATPUMP_ENABLE_FUNCTIONS
+    void createFunctionsInfoPacket(byte *packet, byte functionsPart);
+    bool createPendingFunctionsPacket(byte *packet);
+    bool functionsCacheFresh();
+    bool decodeFunctions(byte* data, int dataLength);
+    bool writeFunctionsPart(heatpumpFunctions const& functions, byte setPart, byte getPart);
+#endif
     int readPacket();
+    int decodePacket(byte* header, byte* data, int dataLength);
+    bool decodeNeeded(int decoder);
+    bool responseObserved(int decoder);
+    bool isPolled(byte type);
+    void decodeResponse(int decoder);
+    void decodePendingResponses();
+    void decodeSettings(byte* data);
+    void decodeRoomTemp(byte* data);
+#if HEATPUMP_ENABLE_TIMERS
+    void decodeTimers(byte* data);
+#endif
+    void decodeStatus(byte* data);
     void readAllPackets();
     void writePacket(byte *packet, int length);
+    bool queuePacket(byte *packet, int length, int txClass); // false only in proxy or listen mode with no room
+    void sendQueuedPacket();
+    void recordTx(int txClass, unsigned long queued);
     void prepareInfoPacket(byte* packet, int length);
     void prepareSetPacket(byte* packet, int length);
 
@@ -228,8 +423,129 @@ class HeatPump
     ON_CONNECT_CALLBACK_SIGNATURE {nullptr};
     SETTINGS_CHANGED_CALLBACK_SIGNATURE {nullptr};
     STATUS_CHANGED_CALLBACK_SIGNATURE {nullptr};
+#if HEATPUMP_ENABLE_PACKET_CALLBACK
     PACKET_CALLBACK_SIGNATURE {nullptr};
+#endif
+#if HEATPUMP_ENABLE_ROOM_TEMP_CALLBACK
     ROOM_TEMP_CHANGED_CALLBACK_SIGNATURE {nullptr};
+#endif
+#if HEATPUMP_ENABLE_FUNCTIONS
+    FUNCTIONS_CALLBACK_SIGNATURE {nullptr};
+#endif
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+    RUNTIME_STATS_CALLBACK_SIGNATURE {nullptr};
+#endif
+
+#if HEATPUMP_ENABLE_SNAPSHOTS
+    // written only by sync(), readers pick the buffer selected by snapshotVersion and retry if it moved on
+    heatpumpSnapshot snapshots[2] {};
+    unsigned long snapshotVersion = 0; // 0 until the first snapshot is published
+    bool snapshotsEnabled = false;
+    void publishSnapshot();
+#endif
+
+#if HEATPUMP_ENABLE_CHANGE_LOG
+    // ring of the last HEATPUMP_CHANGE_LOG_LEN changes, the change with sequence n is at n % HEATPUMP_CHANGE_LOG_LEN
+    heatpumpChange changeLog[HEATPUMP_CHANGE_LOG_LEN] {};
+    unsigned long changeSequence = 0; // sequence of the newest change
+    bool changeLogEnabled = false;
+    // state as of the newest change, compared with the decoded state by logChanges()
+    heatpumpSettings loggedSettings {};
+    heatpumpStatus loggedStatus {};
+    bool loggedConnected = false;
+    void logChange(byte field, const char* text, float value);
+    void logChanges();
+#endif
+
+#if HEATPUMP_ENABLE_IDLE_MODE
+    static const unsigned long IDLE_INFO_INTERVAL_MS = 30000UL;
+    static const unsigned long IDLE_SETTLE_MS        = 60000UL; // nothing changed for this long before slowing down
+    bool idleEnabled = false;
+    unsigned long idleInfoInterval = IDLE_INFO_INTERVAL_MS;
+    unsigned long lastActivity = 0; // last setter call or response that differed from the previous one
+#endif
+
+#if HEATPUMP_ENABLE_WARM_START
+    static const byte SAVED_STATE_VERSION = 1;
+    static const int FUNCTIONS_DATA_LEN = 15;
+    byte staleResponses = 0; // bit per decoder, set while responseData holds a restored payload
+#endif
+
+#if HEATPUMP_ENABLE_HISTORY
+    HeatPumpHistory* history = nullptr;
+#endif
+
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+    static const unsigned long SHORT_CYCLE_MS         = 600000UL;  // 10 minutes
+    static const unsigned long RUNTIME_STATS_SAVE_MS  = 3600000UL; // hourly, flash wears out
+    static const unsigned long RUNTIME_STATS_GAP_MS   = PACKET_SENT_INTERVAL_MS * 10; // longer without sync() is not counted
+    heatpumpRuntimeStats runtimeStats {};
+    bool runtimeStatsEnabled = false;
+    bool runtimeKnown = false;           // connected and a status response has been received
+    bool runtimeOperating = false;       // operating as of runtimeUpdated
+    unsigned long runtimeUpdated = 0;
+    unsigned long runtimeStarted = 0;    // when operating last switched on
+    unsigned long runtimeSaved = 0;
+    unsigned long shortCycleMs = SHORT_CYCLE_MS;
+    unsigned long runtimeStatsSaveMs = RUNTIME_STATS_SAVE_MS;
+    // power model: idleWatts while not operating, runningWatts + wattsPerHz * frequency while operating
+    float idleWatts = 0;
+    float runningWatts = 0;
+    float wattsPerHz = 0;
+    // fractions not yet added to the whole units in runtimeStats
+    unsigned long observedMs = 0;
+    unsigned long operatingMs = 0;
+    unsigned long frequencyMs = 0; // Hz * ms
+    float energyWms = 0;           // W * ms
+    void updateRuntimeStats();
+    static void addCarry(unsigned long& total, unsigned long& carry, unsigned long amount, unsigned long unit);
+#endif
+
+#if HEATPUMP_ENABLE_PROXY
+    // proxy and listen mode, packets are put together byte by byte while the bytes are forwarded
+    static const byte BUS_DIRECT = 0; // connect(), we are the only controller
+    static const byte BUS_PROXY  = 1; // connectProxy()
+    static const byte BUS_LISTEN = 2; // connectListener()
+    static const unsigned long FRAME_GAP_MS = 100; // a pause this long inside a packet drops it
+    static const unsigned long PROXY_IDLE_MS = 50; // both lines quiet this long before a packet of ours goes out
+    struct busFrame {
+      byte data[PACKET_LEN]; // header, up to 16 data bytes, checksum
+      byte length;
+      unsigned long lastByte;
+    };
+    byte busMode = BUS_DIRECT;
+    HardwareSerial* controllerSerial = nullptr;
+    busFrame unitFrame {};
+    busFrame controllerFrame {};
+    bool controllerWaiting = false;  // the controller's last request has not been answered yet
+    unsigned long controllerRequest = 0;
+    byte heldBytes[PACKET_LEN * 2];  // from the controller while the unit answers a packet of ours
+    int heldLength = 0;
+    bool proxyUpdatePending = false; // an update() went out, until the unit reports its settings again
+    unsigned long staleInterval = 0;
+    unsigned long busSeen[INFOMODE_LEN]; // when each info response last went over the bus
+    byte observedSet[PACKET_LEN];    // the controller's last settings packet, until the unit acknowledges it
+    bool observedSetPending = false;
+    void beginBus(byte mode);
+    bool pushFrameByte(busFrame& frame, byte b, unsigned long now);
+    bool frameValid(busFrame& frame);
+    void busRequest(busFrame& frame, unsigned long now);
+    void busResponse(busFrame& frame, bool ours, unsigned long now);
+    bool pollStale(unsigned long now);
+    void proxySync();
+    void releaseHeldBytes();
+    void applyObservedSet();
+#endif
+
+#if HEATPUMP_ENABLE_RESPONSE_HANDLERS
+    static const int MAX_RESPONSE_HANDLERS = 4;
+    struct responseHandler {
+      byte type;
+      RESPONSE_CALLBACK_SIGNATURE;
+    };
+    responseHandler responseHandlers[MAX_RESPONSE_HANDLERS] {};
+    int responseHandlerCount = 0;
+#endif
 
   public:
     // indexes for INFOMODE array (public so they can be optionally passed to sync())
@@ -239,6 +555,33 @@ class HeatPump
     const int RQST_PKT_STATUS    = 4;
     const int RQST_PKT_STANDBY   = 5;
 
+    // transmit priority classes, lower value wins the next bus slot (can be passed to getTxStats())
+    static const int TX_CLASS_CONTROL     = 0; // update()
+    static const int TX_CLASS_REMOTE_TEMP = 1; // setRemoteTemperature()
+    static const int TX_CLASS_CUSTOM      = 2; // sendCustomPacket()
+    static const int TX_CLASS_INFO        = 3; // info polls from sync()
+
+#if HEATPUMP_ENABLE_CHANGE_LOG
+    // heatpumpChange.field, the settings are in the order of heatpumpSettings
+    static const byte CHANGE_POWER                 = 0;
+    static const byte CHANGE_MODE                  = 1;
+    static const byte CHANGE_FAN                   = 2;
+    static const byte CHANGE_VANE                  = 3;
+    static const byte CHANGE_WIDEVANE              = 4;
+    static const byte CHANGE_TEMPERATURE           = 5;
+    static const byte CHANGE_ROOM_TEMPERATURE      = 6;
+    static const byte CHANGE_OPERATING             = 7;
+    static const byte CHANGE_COMPRESSOR_FREQUENCY  = 8;
+    static const byte CHANGE_TIMER_MODE            = 9;
+    static const byte CHANGE_TIMER_ON_SET          = 10;
+    static const byte CHANGE_TIMER_ON_REMAINING    = 11;
+    static const byte CHANGE_TIMER_OFF_SET         = 12;
+    static const byte CHANGE_TIMER_OFF_REMAINING   = 13;
+    static const byte CHANGE_CONNECTED             = 14;
+    // returned by getChanges() when sinceSequence is no longer in the log
+    static const int CHANGES_LOST = -1;
+#endif
+
     // general
     HeatPump();
     bool connect(HardwareSerial *serial);
@@ -249,6 +592,21 @@ class HeatPump
     void sync(byte packetType = PACKET_TYPE_DEFAULT);
     void enableExternalUpdate();
     void disableExternalUpdate();
+#if HEATPUMP_ENABLE_PROXY
+    // proxy mode, instead of connect(): the unit on serial, its wall controller (MHK1, PAR) on controllerSerial.
+    // sync() forwards every byte both ways, decodes the unit's responses, and sends update(), remote
+    // temperature and custom packets in the pauses between the controller's requests. It never polls itself.
+    // bitrate 0 leaves both ports as they are, e.g. begun with custom pins
+    void connectProxy(HardwareSerial* serial, HardwareSerial* controllerSerial, int bitrate = 2400);
+    bool isProxy();
+    // listen mode, instead of connect() where another controller already drives the unit: serial receives
+    // both its requests and the unit's responses. Decoded like in proxy mode, our packets go out in the pauses
+    void connectListener(HardwareSerial* serial, int bitrate = 2400);
+    bool isListening();
+    // proxy and listen mode, poll a response type ourselves once nobody has asked for it for intervalMs,
+    // 0 (the default) never polls
+    void setStaleInterval(unsigned long intervalMs);
+#endif
     void enableAutoUpdate();
     void disableAutoUpdate();
 
@@ -265,7 +623,7 @@ class HeatPump
     void setModeSetting(const char* setting);
     float getTemperature();
     void setTemperature(float setting);
-    void setRemoteTemperature(float setting);
+    bool setRemoteTemperature(float setting); // false if it could not be queued, see proxy mode
     const char* getFanSpeed();
     void setFanSpeed(const char* setting);
     const char* getVaneSetting();
@@ -282,25 +640,109 @@ class HeatPump
     float getRoomTemperature();
     bool getOperating();
     bool isConnected();
+    heatpumpTxStats getTxStats(int txClass);
+    unsigned long getDuplicateResponseCount();
+#if HEATPUMP_ENABLE_LINK_STATS
+    heatpumpLinkStats getLinkStats();
+    // the first byte of the request counted in polls[pollType], 0 past the end
+    static byte getPollCode(int pollType);
+#endif
+
+#if HEATPUMP_ENABLE_CHANGE_LOG
+    // change log
+    void enableChangeLog();
+    unsigned long getChangeSequence(); // sequence of the newest change, 0 if nothing changed yet
+    // copies up to maxChanges changes newer than sinceSequence (oldest first) and returns how many,
+    // CHANGES_LOST if some were already overwritten: read the full state and resume from getChangeSequence()
+    int getChanges(unsigned long sinceSequence, heatpumpChange changes[], int maxChanges);
+#endif
+
+#if HEATPUMP_ENABLE_IDLE_MODE
+    // idle mode: while power is OFF and nothing changed for a minute, poll every intervalMs instead of every 2 s.
+    // Intervals below 2 s are taken as 2 s
+    void enableIdleMode(unsigned long intervalMs = IDLE_INFO_INTERVAL_MS);
+    void disableIdleMode();
+    bool isIdle();
+#endif
+    // how long loop() may sleep before sync() has something to do, 0 if it should be called right away
+    unsigned long getSleepTime();
+
+#if HEATPUMP_ENABLE_WARM_START
+    // warm start: version, bitrate, response count, payloads, functions flag and codes, checksum
+    static const int SAVED_STATE_LEN = 3 + RESPONSE_DECODER_COUNT * RESPONSE_DATA_LEN + 1 + 2 * FUNCTIONS_DATA_LEN + 1;
+    // writes the last known state into buffer (at least SAVED_STATE_LEN bytes), returns the bytes used, 0 if too small
+    int saveState(byte* buffer, int length);
+    // call before connect(), the state is decoded at once and marked stale until the unit reports it again
+    bool restoreState(const byte* buffer, int length);
+    bool isStale(); // true while restored settings or status have not been confirmed by the unit
+#endif
+
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+    // runtime statistics, updated by sync() while connected
+    void enableRuntimeStats();
+    heatpumpRuntimeStats getRuntimeStats();
+    // restore totals saved by the runtime stats callback, e.g. after a reboot
+    void setRuntimeStats(const heatpumpRuntimeStats& stats);
+    void resetRuntimeStats();
+    float getAverageFrequency(); // time weighted, over the operating time
+    void setShortCycleThreshold(unsigned long ms);
+    void setPowerModel(float idleWatts, float runningWatts, float wattsPerHz);
+    // called with the totals every intervalMs (hourly by default), to persist them
+    void setRuntimeStatsCallback(RUNTIME_STATS_CALLBACK_SIGNATURE, unsigned long intervalMs = RUNTIME_STATS_SAVE_MS);
+#endif
+
+#if HEATPUMP_ENABLE_HISTORY
+    // history, sync() records the status into it while connected, pass nullptr to detach
+    void setHistory(HeatPumpHistory* history);
+#endif
 
+#if HEATPUMP_ENABLE_SNAPSHOTS
+    // snapshots, safe to read from other threads/tasks while sync() runs
+    void enableSnapshots();
+    unsigned long getSnapshotVersion();
+    // false (snapshot untouched) if nothing changed since sinceVersion
+    bool getSnapshot(heatpumpSnapshot& snapshot, unsigned long sinceVersion = 0);
+#endif
+
+#if HEATPUMP_ENABLE_FUNCTIONS
     // functions
     // NOTE: These methods have been tested with a PVA (P-series air handler) unit and has not been tested with anything else. Use at your own risk.
-    heatpumpFunctions getFunctions();
+    heatpumpFunctions getFunctions(); // blocking, returns the cached copy while it is fresh
     bool setFunctions(heatpumpFunctions const& functions);
+    // non-blocking, fetched by sync() and delivered to the functions callback. If the unit does not answer,
+    // the callback gets functions for which isValid() is false
+    void requestFunctions();
+    void setFunctionsCacheTTL(unsigned long ttlMs);
+#endif
     
+#if HEATPUMP_ENABLE_FAHRENHEIT
     // helpers
     float FahrenheitToCelsius(int tempF);
     int CelsiusToFahrenheit(float tempC);
+#endif
 
     // callbacks
     void setOnConnectCallback(ON_CONNECT_CALLBACK_SIGNATURE);
     void setSettingsChangedCallback(SETTINGS_CHANGED_CALLBACK_SIGNATURE);
     void setStatusChangedCallback(STATUS_CHANGED_CALLBACK_SIGNATURE);
+#if HEATPUMP_ENABLE_PACKET_CALLBACK
     void setPacketCallback(PACKET_CALLBACK_SIGNATURE);
+#endif
+#if HEATPUMP_ENABLE_ROOM_TEMP_CALLBACK
     void setRoomTempChangedCallback(ROOM_TEMP_CHANGED_CALLBACK_SIGNATURE); // need to deprecate this, is available from setStatusChangedCallback
+#endif
+#if HEATPUMP_ENABLE_FUNCTIONS
+    void setFunctionsCallback(FUNCTIONS_CALLBACK_SIGNATURE);
+#endif
+#if HEATPUMP_ENABLE_RESPONSE_HANDLERS
+    // called with the data bytes (data[0] is the type) of every 0x62 response of responseType, pass nullptr to remove
+    bool setResponseHandler(byte responseType, RESPONSE_CALLBACK_SIGNATURE);
+#endif
 
+#if HEATPUMP_ENABLE_CUSTOM_PACKETS
     // expert users only!
-    void sendCustomPacket(byte data[], int len); 
+    bool sendCustomPacket(byte data[], int len); // false if it could not be queued, see proxy mode
+#endif
 
 };
 #endif
@@ -0,0 +1,152 @@
+/*
+  HeatPumpConfig.h - Compile time feature selection for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __HeatPumpConfig_H__
+#define __HeatPumpConfig_H__
+
+/*
+ * Optional subsystems. Everything is enabled by default, except where noted below; set a feature to 0 to compile it out
+ * completely on boards with little flash or RAM (ESP-01, ATmega328). The Arduino IDE compiles the
+ * library separately from the sketch, so change the defaults here, or pass them as build flags
+ * (PlatformIO build_flags, ESP-IDF component options), e.g. -DHEATPUMP_ENABLE_FUNCTIONS=0
+ *
+ * Run extras/size_report.sh to see what each feature costs on your board.
+ */
+
+// installer function codes: heatpumpFunctions, getFunctions(), setFunctions(), requestFunctions()
+#ifndef HEATPUMP_ENABLE_FUNCTIONS
+#define HEATPUMP_ENABLE_FUNCTIONS 1
+#endif
+
+// decoding of the timer response into heatpumpStatus.timers
+#ifndef HEATPUMP_ENABLE_TIMERS
+#define HEATPUMP_ENABLE_TIMERS 1
+#endif
+
+// sendCustomPacket()
+#ifndef HEATPUMP_ENABLE_CUSTOM_PACKETS
+#define HEATPUMP_ENABLE_CUSTOM_PACKETS 1
+#endif
+
+// FahrenheitToCelsius() and CelsiusToFahrenheit()
+#ifndef HEATPUMP_ENABLE_FAHRENHEIT
+#define HEATPUMP_ENABLE_FAHRENHEIT 1
+#endif
+
+// setPacketCallback(), raw packet debugging
+#ifndef HEATPUMP_ENABLE_PACKET_CALLBACK
+#define HEATPUMP_ENABLE_PACKET_CALLBACK 1
+#endif
+
+// setRoomTempChangedCallback(), deprecated in favour of setStatusChangedCallback()
+#ifndef HEATPUMP_ENABLE_ROOM_TEMP_CALLBACK
+#define HEATPUMP_ENABLE_ROOM_TEMP_CALLBACK 1
+#endif
+
+// setResponseHandler()
+#ifndef HEATPUMP_ENABLE_RESPONSE_HANDLERS
+#define HEATPUMP_ENABLE_RESPONSE_HANDLERS 1
+#endif
+
+// getSnapshot(), double buffered state for readers on other threads/tasks
+#ifndef HEATPUMP_ENABLE_SNAPSHOTS
+#if defined(__AVR__)
+#define HEATPUMP_ENABLE_SNAPSHOTS 0 // single threaded, and the two copies would take RAM even when unused
+#else
+#define HEATPUMP_ENABLE_SNAPSHOTS 1
+#endif
+#endif
+
+// getChanges(), ring of sequenced changes for consumers that resume after a disconnect
+#ifndef HEATPUMP_ENABLE_CHANGE_LOG
+#define HEATPUMP_ENABLE_CHANGE_LOG 1
+#endif
+
+// changes kept by the change log, a consumer further behind than this has to fetch the full state
+#ifndef HEATPUMP_CHANGE_LOG_LEN
+#if defined(ESP8266) || defined(ESP32)
+#define HEATPUMP_CHANGE_LOG_LEN 32
+#else
+#define HEATPUMP_CHANGE_LOG_LEN 8
+#endif
+#endif
+
+// enableIdleMode(), slower polling while the unit is off and nothing changes
+#ifndef HEATPUMP_ENABLE_IDLE_MODE
+#define HEATPUMP_ENABLE_IDLE_MODE 1
+#endif
+
+// connectProxy() and connectListener(), sharing the bus with a wall controller
+#ifndef HEATPUMP_ENABLE_PROXY
+#define HEATPUMP_ENABLE_PROXY 1
+#endif
+
+// saveState() and restoreState(), last known state kept across reboots
+#ifndef HEATPUMP_ENABLE_WARM_START
+#define HEATPUMP_ENABLE_WARM_START 1
+#endif
+
+// getRuntimeStats(), compressor runtime, cycles and estimated energy
+#ifndef HEATPUMP_ENABLE_RUNTIME_STATS
+#define HEATPUMP_ENABLE_RUNTIME_STATS 1
+#endif
+
+// getLinkStats(), protocol counters: connects, checksum errors, round trip times, polls per type
+#ifndef HEATPUMP_ENABLE_LINK_STATS
+#define HEATPUMP_ENABLE_LINK_STATS 1
+#endif
+
+// setHistory(), the history itself only takes memory when a HeatPumpHistory is created
+#ifndef HEATPUMP_ENABLE_HISTORY
+#define HEATPUMP_ENABLE_HISTORY 1
+#endif
+
+// HeatPumpHistory sizes: a sample every 10 s for an hour, minute rollups for 6 hours, hour rollups for a week
+#ifndef HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS
+#define HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS 10000UL
+#endif
+#ifndef HEATPUMP_HISTORY_RAW_LEN
+#define HEATPUMP_HISTORY_RAW_LEN 360
+#endif
+#ifndef HEATPUMP_HISTORY_MINUTE_LEN
+#define HEATPUMP_HISTORY_MINUTE_LEN 360
+#endif
+#ifndef HEATPUMP_HISTORY_HOUR_LEN
+#define HEATPUMP_HISTORY_HOUR_LEN 168
+#endif
+
+// HeatPumpMqttBridge, HeatPumpPacketTrace and HeatPumpMqttGateway, which need the PubSubClient library.
+// Defaults to on only where PubSubClient is installed, so sketches without MQTT build without it
+#ifndef HEATPUMP_ENABLE_MQTT
+#if defined(__has_include)
+#if __has_include(<PubSubClient.h>)
+#define HEATPUMP_ENABLE_MQTT 1
+#endif
+#endif
+#endif
+#ifndef HEATPUMP_ENABLE_MQTT
+#define HEATPUMP_ENABLE_MQTT 0
+#endif
+
+// bytes a callback can capture (see HeatPumpDelegate.h), every callback slot reserves this much
+#ifndef HEATPUMP_DELEGATE_SIZE
+#if defined(ESP8266) || defined(ESP32)
+#define HEATPUMP_DELEGATE_SIZE (4 * sizeof(void*))
+#else
+#define HEATPUMP_DELEGATE_SIZE (2 * sizeof(void*))
+#endif
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+/*
+  HeatPumpDelegate.h - Allocation-free callback type for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __HeatPumpDelegate_H__
+#define __HeatPumpDelegate_H__
+#include <stddef.h>
+#include "HeatPumpConfig.h"
+
+/*
+ * Holds a plain function, or a lambda/functor whose captures fit in HEATPUMP_DELEGATE_SIZE bytes,
+ * inside the object itself. Unlike std::function it never allocates, and it works on every platform
+ * (no <functional> needed). A capture that is too big is a compile error, capture a pointer instead:
+ *
+ *   hp.setStatusChangedCallback([&client](heatpumpStatus status) { ... });
+ */
+
+// placement new without <new>, which is not available on every Arduino core
+struct heatpumpDelegateStorage {};
+inline void* operator new(size_t, heatpumpDelegateStorage, void* where) { return where; }
+inline void operator delete(void*, heatpumpDelegateStorage, void*) {}
+
+// enable_if without <type_traits>, which is not available on every Arduino core either. NULL is an
+// integer to GCC (__null), so it and nullptr are kept away from the Callable constructor and take the
+// function pointer one, which clears the callback as it did for the plain function pointer callbacks
+template<bool Enable> struct heatpumpDelegateIf {};
+template<> struct heatpumpDelegateIf<true> { typedef void type; };
+template<typename T> struct heatpumpDelegateNull { static const bool value = false; };
+template<> struct heatpumpDelegateNull<int> { static const bool value = true; };
+template<> struct heatpumpDelegateNull<long> { static const bool value = true; };
+template<> struct heatpumpDelegateNull<decltype(nullptr)> { static const bool value = true; };
+
+template<typename Signature> class heatpumpDelegate;
+
+template<typename R, typename... Args>
+class heatpumpDelegate<R(Args...)> {
+  private:
+    static const int MANAGE_COPY    = 0;
+    static const int MANAGE_DESTROY = 1;
+
+    union {
+      void* alignPointer;
+      long alignLong;
+      double alignDouble;
+      unsigned char bytes[HEATPUMP_DELEGATE_SIZE];
+    } storage;
+    R (*invoker)(void* callable, Args... args);
+    void (*manager)(int operation, void* dest, const void* src);
+
+    template<typename Callable>
+    static R invoke(void* callable, Args... args) {
+      return (*static_cast<Callable*>(callable))(args...);
+    }
+
+    template<typename Callable>
+    static void manage(int operation, void* dest, const void* src) {
+      if (operation == MANAGE_COPY) {
+        new (heatpumpDelegateStorage(), dest) Callable(*static_cast<const Callable*>(src));
+      } else {
+        static_cast<Callable*>(dest)->~Callable();
+      }
+    }
+
+    template<typename Callable>
+    void init(const Callable& callable) {
+      static_assert(sizeof(Callable) <= HEATPUMP_DELEGATE_SIZE, "callback captures too much for heatpumpDelegate, capture a pointer or raise HEATPUMP_DELEGATE_SIZE");
+      new (heatpumpDelegateStorage(), storage.bytes) Callable(callable);
+      invoker = &invoke<Callable>;
+      manager = &manage<Callable>;
+    }
+
+    void copy(const heatpumpDelegate& other) {
+      invoker = other.invoker;
+      manager = other.manager;
+      if (manager) {
+        manager(MANAGE_COPY, storage.bytes, other.storage.bytes);
+      }
+    }
+
+    void reset() {
+      if (manager) {
+        manager(MANAGE_DESTROY, storage.bytes, nullptr);
+      }
+      invoker = nullptr;
+      manager = nullptr;
+    }
+
+  public:
+    heatpumpDelegate() : invoker(nullptr), manager(nullptr) {}
+    // also nullptr and NULL
+    heatpumpDelegate(R (*function)(Args...)) : invoker(nullptr), manager(nullptr) {
+      if (function) {
+        init(function);
+      }
+    }
+    template<typename Callable, typename = typename heatpumpDelegateIf<!heatpumpDelegateNull<Callable>::value>::type>
+    heatpumpDelegate(const Callable& callable) : invoker(nullptr), manager(nullptr) {
+      init(callable);
+    }
+    heatpumpDelegate(const heatpumpDelegate& other) {
+      copy(other);
+    }
+    ~heatpumpDelegate() {
+      reset();
+    }
+
+    heatpumpDelegate& operator=(const heatpumpDelegate& other) {
+      if (this != &other) {
+        reset();
+        copy(other);
+      }
+      return *this;
+    }
+
+    explicit operator bool() const {
+      return invoker != nullptr;
+    }
+
+    R operator()(Args... args) const {
+      return invoker(const_cast<unsigned char*>(storage.bytes), args...);
+    }
+};
+
+#endif
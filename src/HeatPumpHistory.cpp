@@ -0,0 +1,189 @@
+/*
+  HeatPumpHistory.cpp - Room temperature and compressor history for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+#include "HeatPumpHistory.h"
+
+static_assert(60000UL % HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS == 0, "HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS must divide a minute");
+
+// Constructor /////////////////////////////////////////////////////////////////
+
+HeatPumpHistory::HeatPumpHistory() {
+  clear();
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void HeatPumpHistory::clear() {
+  raw.head = raw.count = 0;
+  minutes.head = minutes.count = 0;
+  hours.head = hours.count = 0;
+  minuteSums = accumulator {};
+  hourSums = accumulator {};
+  started = false;
+}
+
+void HeatPumpHistory::record(const heatpumpStatus& status) {
+  unsigned long now = millis();
+  if (started && now - lastSample < HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS) {
+    return;
+  }
+
+  // keep the sample grid, unless sync() was not called for a whole interval (or history was not fed while
+  // disconnected). Then the grid restarts and the rollups in progress are dropped, they would span the gap
+  if (started && now - lastSample < 2 * HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS) {
+    lastSample += HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS;
+  } else {
+    lastSample = now;
+    minuteSums = accumulator {};
+    hourSums = accumulator {};
+  }
+  started = true;
+  addSample(status);
+}
+
+int HeatPumpHistory::getCount(byte resolution) {
+  switch (resolution) {
+    case RESOLUTION_RAW:    return raw.count;
+    case RESOLUTION_MINUTE: return minutes.count;
+    case RESOLUTION_HOUR:   return hours.count;
+    default:                return 0;
+  }
+}
+
+unsigned long HeatPumpHistory::getInterval(byte resolution) {
+  switch (resolution) {
+    case RESOLUTION_RAW:    return HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS;
+    case RESOLUTION_MINUTE: return MINUTE_MS;
+    case RESOLUTION_HOUR:   return HOUR_MS;
+    default:                return 0;
+  }
+}
+
+heatpumpHistoryPoint HeatPumpHistory::getPoint(byte resolution, int index) {
+  heatpumpHistoryPoint point {};
+  if (index < 0 || index >= getCount(resolution)) {
+    return point;
+  }
+
+  if (resolution == RESOLUTION_RAW) {
+    const sample& s = at(raw, index);
+    point.ageMs = age(raw, index, HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS);
+    point.roomTemperatureMin = point.roomTemperatureMax = point.roomTemperatureMean = decodeTemperature(s.roomTemperature);
+    point.compressorFrequency = s.frequency & ~OPERATING_BIT;
+    point.operating = (s.frequency & OPERATING_BIT) ? 1 : 0;
+    return point;
+  }
+
+  const rollup& r = resolution == RESOLUTION_MINUTE ? at(minutes, index) : at(hours, index);
+  point.ageMs = resolution == RESOLUTION_MINUTE ? age(minutes, index, MINUTE_MS) : age(hours, index, HOUR_MS);
+  point.roomTemperatureMin = decodeTemperature(r.roomTemperatureMin);
+  point.roomTemperatureMax = decodeTemperature(r.roomTemperatureMax);
+  point.roomTemperatureMean = decodeTemperature(r.roomTemperatureMean);
+  point.compressorFrequency = r.frequency;
+  point.operating = r.duty / 255.0;
+  return point;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+template<typename T, int LEN>
+void HeatPumpHistory::push(ring<T, LEN>& points, const T& point, unsigned long interval) {
+  unsigned long now = millis();
+  // whole intervals since the previous point, rounded, so the jitter of sync() does not count
+  unsigned long gap = points.count == 0 ? 1 : (now - points.last + interval / 2) / interval;
+  points.points[points.head] = point;
+  points.gaps[points.head] = gap < 1 ? 1 : (gap > 0xffff ? 0xffff : gap);
+  points.head = (points.head + 1) % LEN;
+  if (points.count < LEN) {
+    points.count++;
+  }
+  points.last = now;
+}
+
+template<typename T, int LEN>
+const T& HeatPumpHistory::at(const ring<T, LEN>& points, int index) {
+  return points.points[(points.head - points.count + index + LEN) % LEN];
+}
+
+// how long ago the point ended: since the newest point, plus the gaps of every point newer than it
+template<typename T, int LEN>
+unsigned long HeatPumpHistory::age(const ring<T, LEN>& points, int index, unsigned long interval) {
+  const unsigned long maxAge = (unsigned long)-1;
+  unsigned long ageMs = millis() - points.last;
+  for (int i = points.count - 1; i > index; i--) {
+    unsigned long gap = points.gaps[(points.head - points.count + i + LEN) % LEN];
+    if (gap > (maxAge - ageMs) / interval) {
+      return maxAge;
+    }
+    ageMs += gap * interval;
+  }
+  return ageMs;
+}
+
+void HeatPumpHistory::addSample(const heatpumpStatus& status) {
+  sample s;
+  s.roomTemperature = encodeTemperature(status.roomTemperature);
+  s.frequency = status.compressorFrequency < 0 ? 0 : (status.compressorFrequency > 127 ? 127 : status.compressorFrequency);
+  if (status.operating) {
+    s.frequency |= OPERATING_BIT;
+  }
+  push(raw, s, HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS);
+
+  // every full minute of samples becomes a minute rollup, every full hour of those an hour rollup
+  accumulate(minuteSums, s.roomTemperature, s.roomTemperature, s.roomTemperature, s.frequency & ~OPERATING_BIT, status.operating ? 255 : 0);
+  if (minuteSums.count == SAMPLES_PER_MINUTE) {
+    rollup minute = rollUp(minuteSums);
+    push(minutes, minute, MINUTE_MS);
+
+    accumulate(hourSums, minute.roomTemperatureMin, minute.roomTemperatureMax, minute.roomTemperatureMean, minute.frequency, minute.duty);
+    if (hourSums.count == MINUTES_PER_HOUR) {
+      push(hours, rollUp(hourSums), HOUR_MS);
+    }
+  }
+}
+
+void HeatPumpHistory::accumulate(accumulator& sums, byte min, byte max, byte mean, byte frequency, byte duty) {
+  if (sums.count == 0 || min < sums.roomTemperatureMin) {
+    sums.roomTemperatureMin = min;
+  }
+  if (sums.count == 0 || max > sums.roomTemperatureMax) {
+    sums.roomTemperatureMax = max;
+  }
+  sums.roomTemperatureSum += mean;
+  sums.frequencySum += frequency;
+  sums.dutySum += duty;
+  sums.count++;
+}
+
+HeatPumpHistory::rollup HeatPumpHistory::rollUp(accumulator& sums) {
+  rollup r;
+  r.roomTemperatureMin = sums.roomTemperatureMin;
+  r.roomTemperatureMax = sums.roomTemperatureMax;
+  // rounded means
+  r.roomTemperatureMean = (sums.roomTemperatureSum + sums.count / 2) / sums.count;
+  r.frequency = (sums.frequencySum + sums.count / 2) / sums.count;
+  r.duty = (sums.dutySum + sums.count / 2) / sums.count;
+  sums = accumulator {};
+  return r;
+}
+
+// half degrees offset by 128, like the half degree temperatures on the wire
+byte HeatPumpHistory::encodeTemperature(float temperature) {
+  int encoded = (int)(temperature * 2 + 128.5);
+  return encoded < 0 ? 0 : (encoded > 255 ? 255 : encoded);
+}
+
+float HeatPumpHistory::decodeTemperature(byte encoded) {
+  return (float)(encoded - 128) / 2;
+}
@@ -0,0 +1,114 @@
+/*
+  HeatPumpHistory.h - Room temperature and compressor history for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+#ifndef __HeatPumpHistory_H__
+#define __HeatPumpHistory_H__
+#include "HeatPump.h"
+
+// one point of the history, a single sample at RESOLUTION_RAW, a rollup of the interval otherwise
+struct heatpumpHistoryPoint {
+  unsigned long ageMs;       // how long ago the point ended
+  float roomTemperatureMin;
+  float roomTemperatureMax;
+  float roomTemperatureMean;
+  float compressorFrequency; // mean
+  float operating;           // fraction of the interval the heat pump was operating, 0 - 1
+};
+
+/*
+ * Fixed memory history of heatpumpStatus, kept at three resolutions: a sample every
+ * HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS for the last hour, and min/max/mean rollups per minute and per hour.
+ * Temperatures are stored in half degrees in one byte, the same encoding the heat pump uses, and each
+ * point keeps how many intervals passed since the one before it, so ages stay right across disconnects
+ * and stalls. The defaults take about 5.2 kB. Attach it with HeatPump::setHistory(), sync() feeds it
+ * from then on. A rollup always covers its full interval: one that a gap interrupts is not recorded.
+ */
+class HeatPumpHistory
+{
+  private:
+    static const unsigned long MINUTE_MS = 60000UL;
+    static const unsigned long HOUR_MS   = 3600000UL;
+    static const int SAMPLES_PER_MINUTE  = MINUTE_MS / HEATPUMP_HISTORY_SAMPLE_INTERVAL_MS;
+    static const int MINUTES_PER_HOUR    = 60;
+    static const byte OPERATING_BIT      = 0x80; // top bit of a sample's frequency byte
+
+    struct sample {
+      byte roomTemperature;
+      byte frequency; // 0 - 127 Hz, OPERATING_BIT set while operating
+    };
+    struct rollup {
+      byte roomTemperatureMin;
+      byte roomTemperatureMax;
+      byte roomTemperatureMean;
+      byte frequency;
+      byte duty; // 0 - 255
+    };
+    // running sums of the interval being rolled up
+    struct accumulator {
+      byte roomTemperatureMin;
+      byte roomTemperatureMax;
+      unsigned long roomTemperatureSum;
+      unsigned long frequencySum;
+      unsigned long dutySum;
+      int count;
+    };
+    // a ring of points: the oldest is at (head - count), the newest at head - 1
+    template<typename T, int LEN>
+    struct ring {
+      T points[LEN];
+      uint16_t gaps[LEN]; // intervals between the point before and this one, usually 1
+      int head;
+      int count;
+      unsigned long last; // millis() when the newest point was added
+    };
+
+    ring<sample, HEATPUMP_HISTORY_RAW_LEN> raw;
+    ring<rollup, HEATPUMP_HISTORY_MINUTE_LEN> minutes;
+    ring<rollup, HEATPUMP_HISTORY_HOUR_LEN> hours;
+    accumulator minuteSums;
+    accumulator hourSums;
+    bool started;
+    unsigned long lastSample;
+
+    template<typename T, int LEN>
+    void push(ring<T, LEN>& points, const T& point, unsigned long interval);
+    template<typename T, int LEN>
+    const T& at(const ring<T, LEN>& points, int index);
+    template<typename T, int LEN>
+    unsigned long age(const ring<T, LEN>& points, int index, unsigned long interval);
+
+    void addSample(const heatpumpStatus& status);
+    void accumulate(accumulator& sums, byte min, byte max, byte mean, byte frequency, byte duty);
+    rollup rollUp(accumulator& sums);
+
+    static byte encodeTemperature(float temperature);
+    static float decodeTemperature(byte encoded);
+
+  public:
+    static const byte RESOLUTION_RAW    = 0;
+    static const byte RESOLUTION_MINUTE = 1;
+    static const byte RESOLUTION_HOUR   = 2;
+
+    HeatPumpHistory();
+    void clear();
+    // takes a sample when the sample interval has passed, called by HeatPump::sync()
+    void record(const heatpumpStatus& status);
+
+    // query, index 0 is the oldest point. getPoint() adds up the gaps of the newer points, so walk from
+    // the newest one if the rings are long
+    int getCount(byte resolution);
+    unsigned long getInterval(byte resolution);
+    heatpumpHistoryPoint getPoint(byte resolution, int index);
+};
+#endif
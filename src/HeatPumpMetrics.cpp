@@ -0,0 +1,276 @@
+/*
+  HeatPumpMetrics.cpp - Prometheus text format exporter for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "HeatPumpMetrics.h"
+
+// label values, indexed by TX_CLASS_*
+static const char* const TX_CLASS_NAMES[] = {"control", "remote_temp", "custom", "info"};
+
+#if HEATPUMP_ENABLE_LINK_STATS
+// label values, indexed like heatpumpLinkStats::polls
+static const char* const POLL_TYPE_NAMES[HEATPUMP_POLL_TYPES] = {
+  "settings", "room_temp", "status", "0x04", "timers", "standby", "functions"
+};
+#endif
+
+// Constructor /////////////////////////////////////////////////////////////////
+
+HeatPumpMetrics::HeatPumpMetrics(HeatPump& hp) : hp(hp), gauges(), gaugeCount(0), connected(false),
+  settings(), status(), duplicateResponses(0), txStats(), out(nullptr), chunkLength(0), written(0) {
+#if HEATPUMP_ENABLE_LINK_STATS
+  linkStats = heatpumpLinkStats {};
+#endif
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+  runtimeStats = heatpumpRuntimeStats {};
+#endif
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+bool HeatPumpMetrics::addGauge(const char* name, const char* help, unsigned long (*read)()) {
+  if (gaugeCount >= GAUGES_LEN) {
+    return false;
+  }
+  gauges[gaugeCount++] = gauge {name, help, read, 0};
+  return true;
+}
+
+void HeatPumpMetrics::capture() {
+  connected = hp.isConnected();
+  settings = hp.getSettings();
+  status = hp.getStatus();
+  duplicateResponses = hp.getDuplicateResponseCount();
+  for (int i = HeatPump::TX_CLASS_CONTROL; i <= HeatPump::TX_CLASS_INFO; i++) {
+    txStats[i] = hp.getTxStats(i);
+  }
+#if HEATPUMP_ENABLE_LINK_STATS
+  linkStats = hp.getLinkStats();
+#endif
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+  runtimeStats = hp.getRuntimeStats();
+#endif
+  for (int i = 0; i < gaugeCount; i++) {
+    gauges[i].value = gauges[i].read();
+  }
+}
+
+size_t HeatPumpMetrics::length() {
+  return render(nullptr);
+}
+
+size_t HeatPumpMetrics::write(Print& out) {
+  return render(&out);
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+size_t HeatPumpMetrics::render(Print* out) {
+  this->out = out;
+  chunkLength = 0;
+  written = 0;
+
+  metric("heatpump_connected", "Whether the link to the heat pump is up.", "gauge", connected);
+
+#if HEATPUMP_ENABLE_LINK_STATS
+  metric("heatpump_link_connects_total", "CONNECT packets sent, one per bitrate tried.", "counter", linkStats.connects);
+  metric("heatpump_link_reconnects_total", "Connects because the link went quiet.", "counter", linkStats.reconnects);
+  metric("heatpump_link_packets_received_total", "Packets with a valid checksum.", "counter", linkStats.packetsReceived);
+  metric("heatpump_link_checksum_errors_total", "Packets dropped for a bad checksum.", "counter", linkStats.checksumErrors);
+  metric("heatpump_link_header_errors_total", "Start bytes not followed by a valid header.", "counter", linkStats.headerErrors);
+
+  header("heatpump_link_rtt_seconds", "Time from a request to the start of its response.", "summary");
+  sample("heatpump_link_rtt_seconds_sum", nullptr, nullptr);
+  putMillis(linkStats.totalRttMs);
+  put('\n');
+  sample("heatpump_link_rtt_seconds_count", nullptr, nullptr);
+  putUnsigned(linkStats.rttSamples);
+  put('\n');
+  header("heatpump_link_rtt_max_seconds", "Longest round trip seen.", "gauge");
+  sample("heatpump_link_rtt_max_seconds", nullptr, nullptr);
+  putMillis(linkStats.maxRttMs);
+  put('\n');
+
+  header("heatpump_polls_total", "Info requests sent, by type.", "counter");
+  for (int i = 0; i < HEATPUMP_POLL_TYPES; i++) {
+    sample("heatpump_polls_total", "type", POLL_TYPE_NAMES[i]);
+    putUnsigned(linkStats.polls[i]);
+    put('\n');
+  }
+#endif
+
+  metric("heatpump_duplicate_responses_total", "Responses identical to the previous one of their type.", "counter",
+         duplicateResponses);
+
+  header("heatpump_tx_packets_total", "Packets sent, by priority class.", "counter");
+  for (int i = HeatPump::TX_CLASS_CONTROL; i <= HeatPump::TX_CLASS_INFO; i++) {
+    sample("heatpump_tx_packets_total", "class", TX_CLASS_NAMES[i]);
+    putUnsigned(txStats[i].sent);
+    put('\n');
+  }
+  header("heatpump_tx_wait_seconds_total", "Time packets waited for a bus slot, by priority class.", "counter");
+  for (int i = HeatPump::TX_CLASS_CONTROL; i <= HeatPump::TX_CLASS_INFO; i++) {
+    sample("heatpump_tx_wait_seconds_total", "class", TX_CLASS_NAMES[i]);
+    putMillis(txStats[i].totalWaitMs);
+    put('\n');
+  }
+  header("heatpump_tx_wait_max_seconds", "Longest wait for a bus slot, by priority class.", "gauge");
+  for (int i = HeatPump::TX_CLASS_CONTROL; i <= HeatPump::TX_CLASS_INFO; i++) {
+    sample("heatpump_tx_wait_max_seconds", "class", TX_CLASS_NAMES[i]);
+    putMillis(txStats[i].maxWaitMs);
+    put('\n');
+  }
+
+  // decoded state
+  header("heatpump_settings_info", "Current settings, as labels.", "gauge");
+  put("heatpump_settings_info{power=");
+  putLabelValue(settings.power);
+  put(",mode=");
+  putLabelValue(settings.mode);
+  put(",fan=");
+  putLabelValue(settings.fan);
+  put(",vane=");
+  putLabelValue(settings.vane);
+  put(",wide_vane=");
+  putLabelValue(settings.wideVane);
+  put("} 1\n");
+  metric("heatpump_power", "1 while the heat pump is switched on.", "gauge",
+         settings.power && strcmp(settings.power, "ON") == 0);
+  header("heatpump_setpoint_celsius", "Target temperature.", "gauge");
+  sample("heatpump_setpoint_celsius", nullptr, nullptr);
+  putTenths(settings.temperature);
+  put('\n');
+  header("heatpump_room_temperature_celsius", "Room temperature measured by the unit.", "gauge");
+  sample("heatpump_room_temperature_celsius", nullptr, nullptr);
+  putTenths(status.roomTemperature);
+  put('\n');
+  metric("heatpump_operating", "1 while the compressor is running.", "gauge", status.operating);
+  metric("heatpump_compressor_frequency_hertz", "Compressor frequency.", "gauge", status.compressorFrequency);
+
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+  metric("heatpump_observed_seconds_total", "Time the status was followed, see enableRuntimeStats().", "counter",
+         runtimeStats.observedSeconds);
+  metric("heatpump_operating_seconds_total", "Time the compressor was running.", "counter",
+         runtimeStats.operatingSeconds);
+  metric("heatpump_compressor_cycles_total", "Operating periods started.", "counter", runtimeStats.cycles);
+  metric("heatpump_compressor_short_cycles_total", "Operating periods shorter than the short cycle threshold.",
+         "counter", runtimeStats.shortCycles);
+  metric("heatpump_compressor_frequency_hertz_seconds_total", "Compressor frequency integrated over time.", "counter",
+         runtimeStats.frequencySeconds);
+  metric("heatpump_energy_watt_hours_total", "Energy estimated from the power model.", "counter",
+         runtimeStats.energyWh);
+#endif
+
+  for (int i = 0; i < gaugeCount; i++) {
+    metric(gauges[i].name, gauges[i].help, "gauge", gauges[i].value);
+  }
+
+  if (out && chunkLength > 0) {
+    out->write((const uint8_t*)chunk, chunkLength);
+    chunkLength = 0;
+  }
+  return written;
+}
+
+void HeatPumpMetrics::put(char c) {
+  written++;
+  if (!out) {
+    return;
+  }
+  chunk[chunkLength++] = c;
+  if (chunkLength == CHUNK_LEN) {
+    out->write((const uint8_t*)chunk, chunkLength);
+    chunkLength = 0;
+  }
+}
+
+void HeatPumpMetrics::put(const char* s) {
+  while (*s) {
+    put(*s++);
+  }
+}
+
+void HeatPumpMetrics::putUnsigned(unsigned long value) {
+  char digits[12];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (count > 0) {
+    put(digits[--count]);
+  }
+}
+
+void HeatPumpMetrics::putTenths(float value) {
+  long tenths = (long)(value * 10 + (value < 0 ? -0.5 : 0.5));
+  if (tenths < 0) {
+    put('-');
+    tenths = -tenths;
+  }
+  putUnsigned(tenths / 10);
+  put('.');
+  put((char)('0' + tenths % 10));
+}
+
+void HeatPumpMetrics::putMillis(unsigned long ms) {
+  putUnsigned(ms / 1000);
+  put('.');
+  unsigned long fraction = ms % 1000;
+  put((char)('0' + fraction / 100));
+  put((char)('0' + fraction / 10 % 10));
+  put((char)('0' + fraction % 10));
+}
+
+void HeatPumpMetrics::putLabelValue(const char* value) {
+  put('"');
+  for (; value && *value; value++) {
+    if (*value == '"' || *value == '\\') {
+      put('\\');
+    }
+    put(*value);
+  }
+  put('"');
+}
+
+void HeatPumpMetrics::header(const char* name, const char* help, const char* type) {
+  put("# HELP ");
+  put(name);
+  put(' ');
+  put(help);
+  put("\n# TYPE ");
+  put(name);
+  put(' ');
+  put(type);
+  put('\n');
+}
+
+void HeatPumpMetrics::sample(const char* name, const char* labelName, const char* labelValue) {
+  put(name);
+  if (labelName) {
+    put('{');
+    put(labelName);
+    put('=');
+    putLabelValue(labelValue);
+    put('}');
+  }
+  put(' ');
+}
+
+void HeatPumpMetrics::metric(const char* name, const char* help, const char* type, unsigned long value) {
+  header(name, help, type);
+  sample(name, nullptr, nullptr);
+  putUnsigned(value);
+  put('\n');
+}
@@ -0,0 +1,84 @@
+/*
+  HeatPumpMetrics.h - Prometheus text format exporter for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __HeatPumpMetrics_H__
+#define __HeatPumpMetrics_H__
+#include <Print.h>
+#include "HeatPump.h"
+
+/*
+ * Renders the link counters, transmit statistics, decoded state and runtime totals of a HeatPump in the
+ * Prometheus text format, straight into any Print (a WiFiClient, PubSubClient, a file) through a small
+ * chunk buffer. capture() copies the values first, so length() and write() agree on every byte and the
+ * length can go in a Content-Length or MQTT header before the body is streamed.
+ */
+class HeatPumpMetrics
+{
+  private:
+    static const int CHUNK_LEN = 64;
+    static const int GAUGES_LEN = 4;
+
+    struct gauge {
+      const char* name;
+      const char* help;
+      unsigned long (*read)();
+      unsigned long value;
+    };
+
+    HeatPump& hp;
+    gauge gauges[GAUGES_LEN];
+    int gaugeCount;
+
+    // captured values
+    bool connected;
+    heatpumpSettings settings;
+    heatpumpStatus status;
+    unsigned long duplicateResponses;
+    heatpumpTxStats txStats[4]; // per TX_CLASS_*
+#if HEATPUMP_ENABLE_LINK_STATS
+    heatpumpLinkStats linkStats;
+#endif
+#if HEATPUMP_ENABLE_RUNTIME_STATS
+    heatpumpRuntimeStats runtimeStats;
+#endif
+
+    // rendering, out is nullptr while only counting
+    Print* out;
+    char chunk[CHUNK_LEN];
+    int chunkLength;
+    size_t written;
+
+    size_t render(Print* out);
+    void put(char c);
+    void put(const char* s);
+    void putUnsigned(unsigned long value);
+    void putTenths(float value);
+    void putMillis(unsigned long ms); // as seconds
+    void putLabelValue(const char* value);
+    void header(const char* name, const char* help, const char* type);
+    void sample(const char* name, const char* labelName, const char* labelValue);
+    void metric(const char* name, const char* help, const char* type, unsigned long value);
+
+  public:
+    explicit HeatPumpMetrics(HeatPump& hp);
+    // an extra gauge, e.g. free heap, read on capture(). false if GAUGES_LEN are already added
+    bool addGauge(const char* name, const char* help, unsigned long (*read)());
+    // call from the thread that calls sync(), then length() and write() as often as needed
+    void capture();
+    size_t length();
+    size_t write(Print& out);
+};
+
+#endif
@@ -0,0 +1,509 @@
+/*
+  HeatPumpMqttBridge.cpp - Publishes HeatPump state to MQTT without heap allocations
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "HeatPumpMqttBridge.h"
+#if HEATPUMP_ENABLE_MQTT
+
+// JsonObjectWriter ////////////////////////////////////////////////////////////
+
+JsonObjectWriter::JsonObjectWriter(Print* out) : out(out), chunkLength(0), written(0), first(true) {}
+
+void JsonObjectWriter::begin() {
+  put('{');
+}
+
+void JsonObjectWriter::end() {
+  put('}');
+  if (out && chunkLength > 0) {
+    out->write((const uint8_t*)chunk, chunkLength);
+    chunkLength = 0;
+  }
+}
+
+void JsonObjectWriter::add(const char* key, const char* value) {
+  putKey(key);
+  if (value) {
+    putString(value);
+  } else {
+    put("null");
+  }
+}
+
+void JsonObjectWriter::add(const char* key, int value) {
+  putKey(key);
+  if (value < 0) {
+    put('-');
+  }
+  putUnsigned(value < 0 ? -(long)value : value);
+}
+
+void JsonObjectWriter::add(const char* key, unsigned long value) {
+  putKey(key);
+  putUnsigned(value);
+}
+
+void JsonObjectWriter::add(const char* key, float value) {
+  putKey(key);
+  long tenths = (long)(value * 10 + (value < 0 ? -0.5 : 0.5));
+  if (tenths < 0) {
+    put('-');
+    tenths = -tenths;
+  }
+  putUnsigned(tenths / 10);
+  put('.');
+  put((char)('0' + tenths % 10));
+}
+
+void JsonObjectWriter::add(const char* key, bool value) {
+  putKey(key);
+  put(value ? "true" : "false");
+}
+
+size_t JsonObjectWriter::length() const {
+  return written;
+}
+
+void JsonObjectWriter::put(char c) {
+  written++;
+  if (!out) {
+    return;
+  }
+  chunk[chunkLength++] = c;
+  if (chunkLength == CHUNK_LEN) {
+    out->write((const uint8_t*)chunk, chunkLength);
+    chunkLength = 0;
+  }
+}
+
+void JsonObjectWriter::put(const char* s) {
+  while (*s) {
+    put(*s++);
+  }
+}
+
+void JsonObjectWriter::putString(const char* s) {
+  put('"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      put('\\');
+    }
+    put(*s);
+  }
+  put('"');
+}
+
+void JsonObjectWriter::putKey(const char* key) {
+  if (!first) {
+    put(',');
+  }
+  first = false;
+  putString(key);
+  put(':');
+}
+
+void JsonObjectWriter::putUnsigned(unsigned long value) {
+  char digits[12];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (count > 0) {
+    put(digits[--count]);
+  }
+}
+
+// HeatPumpMqttBridge //////////////////////////////////////////////////////////
+
+// command topic suffixes, indexed by COMMAND_*
+const HeatPumpMqttBridge::commandTopic HeatPumpMqttBridge::COMMAND_TOPICS[] = {
+  {"power", 5}, {"mode", 4}, {"temperature", 11}, {"fan", 3}, {"vane", 4}, {"widevane", 8}, {"remoteTemp", 10}
+};
+
+HeatPumpMqttBridge::HeatPumpMqttBridge(PubSubClient& client, const char* settingsTopic, const char* statusTopic, const char* timersTopic)
+  : client(client), settingsTopic(settingsTopic), statusTopic(statusTopic), timersTopic(timersTopic),
+    retainSettings(true), fahrenheit(false),
+    lastSettings(), lastStatus(), settingsPublished(false), statusPublished(false),
+    commandPrefix(nullptr), commandPrefixLength(0), staged(), stagedCommands(0),
+    published(0), skipped(0), failed(0), heapMin(UINT32_MAX) {}
+
+bool HeatPumpMqttBridge::publishSettings(const heatpumpSettings& settings, bool force) {
+  if (settingsPublished && !force && settings == lastSettings) {
+    skipped++;
+    return true;
+  }
+  bool ok = publishJson(settingsTopic, retainSettings, [this, &settings](JsonObjectWriter& json) {
+    writeSettings(json, settings);
+  });
+  if (ok) {
+    lastSettings = settings;
+    settingsPublished = true;
+  }
+  return ok;
+}
+
+bool HeatPumpMqttBridge::publishStatus(const heatpumpStatus& status, bool force) {
+  bool ok = true;
+  // the status topic only carries room temperature and operating, the compressor frequency alone is not a change
+  if (!statusPublished || force ||
+      status.roomTemperature != lastStatus.roomTemperature || status.operating != lastStatus.operating) {
+    ok = publishJson(statusTopic, true, [this, &status](JsonObjectWriter& json) {
+      writeStatus(json, status);
+    });
+  } else {
+    skipped++;
+  }
+
+  if (!statusPublished || force || status.timers != lastStatus.timers) {
+    ok = publishJson(timersTopic, true, [&status](JsonObjectWriter& json) {
+      writeTimers(json, status.timers);
+    }) && ok;
+  } else {
+    skipped++;
+  }
+
+  if (ok) {
+    lastStatus = status;
+    statusPublished = true;
+  }
+  return ok;
+}
+
+bool HeatPumpMqttBridge::publishStats(const char* topic) {
+  sampleHeap();
+#if defined(ESP8266) || defined(ESP32)
+  uint32_t heapFree = ESP.getFreeHeap();
+#else
+  uint32_t heapFree = 0;
+#endif
+  return publishJson(topic, false, [this, heapFree](JsonObjectWriter& json) {
+    json.add("published", published);
+    json.add("skipped", skipped);
+    json.add("failed", failed);
+#if defined(ESP8266) || defined(ESP32)
+    json.add("heapFree", (unsigned long)heapFree);
+    json.add("heapMin", (unsigned long)heapMin);
+#else
+    (void)heapFree; // the free heap is not known here, better no keys than made up values
+#endif
+  });
+}
+
+void HeatPumpMqttBridge::setRetainSettings(bool retain) {
+  retainSettings = retain;
+}
+
+void HeatPumpMqttBridge::setFahrenheit(bool fahrenheit) {
+  this->fahrenheit = fahrenheit;
+}
+
+void HeatPumpMqttBridge::invalidate() {
+  settingsPublished = false;
+  statusPublished = false;
+}
+
+uint32_t HeatPumpMqttBridge::getHeapMin() {
+  return heapMin;
+}
+
+void HeatPumpMqttBridge::setCommandPrefix(const char* commandPrefix) {
+  this->commandPrefix = commandPrefix;
+  commandPrefixLength = strlen(commandPrefix);
+}
+
+bool HeatPumpMqttBridge::handleCommand(const char* topic, const byte* payload, unsigned int length) {
+  if (!commandPrefix || strncmp(topic, commandPrefix, commandPrefixLength) != 0 || topic[commandPrefixLength] != '/') {
+    return false;
+  }
+  const char* suffix = topic + commandPrefixLength + 1;
+  size_t suffixLength = strlen(suffix);
+
+  // length and first letter tell the commands apart, one compare confirms
+  byte command;
+  switch (suffix[0]) {
+    case 'p': command = COMMAND_POWER; break;
+    case 'm': command = COMMAND_MODE; break;
+    case 't': command = COMMAND_TEMPERATURE; break;
+    case 'f': command = COMMAND_FAN; break;
+    case 'v': command = COMMAND_VANE; break;
+    case 'w': command = COMMAND_WIDEVANE; break;
+    case 'r': command = COMMAND_REMOTE_TEMP; break;
+    default: return false;
+  }
+  if (suffixLength != COMMAND_TOPICS[command].length || memcmp(suffix, COMMAND_TOPICS[command].name, suffixLength) != 0) {
+    return false;
+  }
+
+  stage(command, (const char*)payload, length);
+  return true;
+}
+
+void HeatPumpMqttBridge::stage(byte command, const char* value, unsigned int length) {
+  if (command >= COMMAND_COUNT || length >= COMMAND_VALUE_LEN) {
+    return;
+  }
+  memcpy(staged[command], value, length);
+  staged[command][length] = '\0';
+  stagedCommands |= (1 << command);
+}
+
+bool HeatPumpMqttBridge::isStaged(byte command) {
+  return command < COMMAND_COUNT && (stagedCommands & (1 << command));
+}
+
+bool HeatPumpMqttBridge::applyCommands(HeatPump& hp) {
+  byte commands = stagedCommands;
+  if (!commands) {
+    return true;
+  }
+  stagedCommands = 0;
+
+  if (commands & (1 << COMMAND_POWER)) {
+    hp.setPowerSetting(staged[COMMAND_POWER]);
+  }
+  if (commands & (1 << COMMAND_MODE)) {
+    hp.setModeSetting(staged[COMMAND_MODE]);
+  }
+  if (commands & (1 << COMMAND_TEMPERATURE)) {
+    hp.setTemperature(readTemperature(staged[COMMAND_TEMPERATURE]));
+  }
+  if (commands & (1 << COMMAND_FAN)) {
+    hp.setFanSpeed(staged[COMMAND_FAN]);
+  }
+  if (commands & (1 << COMMAND_VANE)) {
+    hp.setVaneSetting(staged[COMMAND_VANE]);
+  }
+  if (commands & (1 << COMMAND_WIDEVANE)) {
+    hp.setWideVaneSetting(staged[COMMAND_WIDEVANE]);
+  }
+  bool ok = true;
+  if (commands & (1 << COMMAND_REMOTE_TEMP)) {
+    ok = hp.setRemoteTemperature(readTemperature(staged[COMMAND_REMOTE_TEMP])); // queued by the library, not part of the update
+  }
+
+  // everything that arrived since the last loop() goes out in one set packet
+  if (commands & ~(1 << COMMAND_REMOTE_TEMP)) {
+    return hp.update() && ok;
+  }
+  return ok;
+}
+
+void HeatPumpMqttBridge::writeSettings(JsonObjectWriter& json, const heatpumpSettings& settings) {
+  json.add("power", settings.power);
+  json.add("mode", settings.mode);
+  writeTemperature(json, "temperature", settings.temperature);
+  json.add("fan", settings.fan);
+  json.add("vane", settings.vane);
+  json.add("wideVane", settings.wideVane);
+}
+
+void HeatPumpMqttBridge::writeStatus(JsonObjectWriter& json, const heatpumpStatus& status) {
+  writeTemperature(json, "roomTemperature", status.roomTemperature);
+  json.add("operating", status.operating);
+}
+
+void HeatPumpMqttBridge::writeTimers(JsonObjectWriter& json, const heatpumpTimers& timers) {
+  json.add("mode", timers.mode);
+  json.add("onMins", timers.onMinutesSet);
+  json.add("onRemainMins", timers.onMinutesRemaining);
+  json.add("offMins", timers.offMinutesSet);
+  json.add("offRemainMins", timers.offMinutesRemaining);
+}
+
+// same rounding as HeatPump::CelsiusToFahrenheit() and FahrenheitToCelsius(), which may be compiled out
+void HeatPumpMqttBridge::writeTemperature(JsonObjectWriter& json, const char* key, float celsius) {
+  if (fahrenheit) {
+    json.add(key, (int)(celsius * 1.8 + 32 + 0.5));
+  } else {
+    json.add(key, celsius);
+  }
+}
+
+float HeatPumpMqttBridge::readTemperature(const char* value) {
+  float temperature = atof(value);
+  if (fahrenheit && temperature != 0) { // 0 switches the remote temperature off in either unit
+    return round((temperature - 32) / 1.8 * 2) / 2;
+  }
+  return temperature;
+}
+
+// the JSON is written twice: once to count its length for the MQTT header, once into the client
+template<typename Writer>
+bool HeatPumpMqttBridge::publishJson(const char* topic, bool retain, Writer write) {
+  JsonObjectWriter counter(nullptr);
+  counter.begin();
+  write(counter);
+  counter.end();
+
+  sampleHeap();
+  if (!client.beginPublish(topic, counter.length(), retain)) {
+    failed++;
+    return false;
+  }
+  JsonObjectWriter json(&client);
+  json.begin();
+  write(json);
+  json.end();
+  if (!client.endPublish()) {
+    failed++;
+    return false;
+  }
+  published++;
+  return true;
+}
+
+void HeatPumpMqttBridge::sampleHeap() {
+#if defined(ESP8266) || defined(ESP32)
+  uint32_t heapFree = ESP.getFreeHeap();
+  if (heapFree < heapMin) {
+    heapMin = heapFree;
+  }
+#endif
+}
+
+// HeatPumpPacketTrace /////////////////////////////////////////////////////////
+
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+HeatPumpPacketTrace::HeatPumpPacketTrace(PubSubClient& client, const char* topic, unsigned long bytesPerSecond,
+                                         unsigned long flushIntervalMs)
+  : client(client), topic(topic), bytesPerSecond(bytesPerSecond), flushInterval(flushIntervalMs),
+    batch(), batchLength(0), batchStart(0), dropped(0),
+    budget(encodedLength(BATCH_LEN)), budgetUpdated(millis()), batches(0), droppedTotal(0) {}
+
+void HeatPumpPacketTrace::add(const byte* packet, unsigned int length, const char* packetDirection) {
+  if (length > 0xff || batchLength + FRAME_HEADER_LEN + (int)length > BATCH_LEN) {
+    dropped++;
+    droppedTotal++;
+    return;
+  }
+
+  unsigned long now = millis();
+  if (batchLength == 0) {
+    batchStart = now;
+    batch[0] = BATCH_VERSION;
+    // dropped count is filled in when publishing, it can still grow
+    batch[3] = batchStart & 0xff;
+    batch[4] = (batchStart >> 8) & 0xff;
+    batch[5] = (batchStart >> 16) & 0xff;
+    batch[6] = (batchStart >> 24) & 0xff;
+    batchLength = BATCH_HEADER_LEN;
+  }
+
+  // "packetSent", "packetRecv" or "customPacket"
+  byte direction = packetDirection[0] == 'c' ? DIRECTION_CUSTOM :
+                   packetDirection[6] == 'S' ? DIRECTION_SENT : DIRECTION_RECEIVED;
+  unsigned long offset = now - batchStart;
+  if (offset > 0xffff) {
+    offset = 0xffff;
+  }
+
+  byte* frame = batch + batchLength;
+  frame[0] = offset & 0xff;
+  frame[1] = (offset >> 8) & 0xff;
+  frame[2] = direction;
+  frame[3] = length;
+  memcpy(frame + FRAME_HEADER_LEN, packet, length);
+  batchLength += FRAME_HEADER_LEN + length;
+}
+
+bool HeatPumpPacketTrace::loop() {
+  refillBudget();
+  if (batchLength == 0) {
+    return true;
+  }
+  bool due = batchLength > BATCH_LEN * 3 / 4 || millis() - batchStart > flushInterval;
+  if (!due || budget < encodedLength(batchLength)) {
+    return true;
+  }
+  return publishBatch();
+}
+
+unsigned long HeatPumpPacketTrace::getBatches() {
+  return batches;
+}
+
+unsigned long HeatPumpPacketTrace::getDropped() {
+  return droppedTotal;
+}
+
+size_t HeatPumpPacketTrace::encodedLength(int length) {
+  return (length + 2) / 3 * 4;
+}
+
+void HeatPumpPacketTrace::refillBudget() {
+  const unsigned long burst = encodedLength(BATCH_LEN); // one full batch at most
+  if (bytesPerSecond == 0) {
+    budget = burst; // no cap
+    return;
+  }
+  unsigned long now = millis();
+  unsigned long earned = (now - budgetUpdated) * bytesPerSecond / 1000;
+  if (earned == 0) {
+    return;
+  }
+  // move on only by the time that was paid out, the rest counts towards the next byte
+  budgetUpdated += earned * 1000 / bytesPerSecond;
+  budget += earned;
+  if (budget >= burst) {
+    budget = burst;
+    budgetUpdated = now;
+  }
+}
+
+bool HeatPumpPacketTrace::publishBatch() {
+  unsigned int droppedBefore = dropped > 0xffff ? 0xffff : dropped;
+  batch[1] = droppedBefore & 0xff;
+  batch[2] = (droppedBefore >> 8) & 0xff;
+
+  // the batch stays until the broker took it, a failed publish is tried again on a later loop()
+  size_t length = encodedLength(batchLength);
+  if (!client.beginPublish(topic, length, false)) {
+    return false;
+  }
+  char chunk[ENCODE_CHUNK_LEN];
+  int chunkLength = 0;
+  for (int idx = 0; idx < batchLength; idx += 3) {
+    int remaining = batchLength - idx;
+    uint32_t triple = (uint32_t)batch[idx] << 16;
+    if (remaining > 1) {
+      triple |= (uint32_t)batch[idx + 1] << 8;
+    }
+    if (remaining > 2) {
+      triple |= batch[idx + 2];
+    }
+    chunk[chunkLength++] = BASE64_ALPHABET[(triple >> 18) & 0x3f];
+    chunk[chunkLength++] = BASE64_ALPHABET[(triple >> 12) & 0x3f];
+    chunk[chunkLength++] = remaining > 1 ? BASE64_ALPHABET[(triple >> 6) & 0x3f] : '=';
+    chunk[chunkLength++] = remaining > 2 ? BASE64_ALPHABET[triple & 0x3f] : '=';
+    if (chunkLength == ENCODE_CHUNK_LEN) {
+      client.write((const uint8_t*)chunk, chunkLength);
+      chunkLength = 0;
+    }
+  }
+  if (chunkLength > 0) {
+    client.write((const uint8_t*)chunk, chunkLength);
+  }
+  if (!client.endPublish()) {
+    return false;
+  }
+  budget -= length;
+  batchLength = 0;
+  dropped = 0;
+  batches++;
+  return true;
+}
+
+#endif
@@ -0,0 +1,203 @@
+/*
+  HeatPumpMqttBridge.h - Publishes HeatPump state to MQTT without heap allocations
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __HeatPumpMqttBridge_H__
+#define __HeatPumpMqttBridge_H__
+#include "HeatPumpConfig.h"
+#if HEATPUMP_ENABLE_MQTT
+#include <PubSubClient.h>
+#include "HeatPump.h"
+
+/*
+ * Writes a flat JSON object straight to the MQTT client in small chunks, or, without a client, only
+ * counts the bytes it would write. Everything lives in the object, nothing is allocated.
+ */
+class JsonObjectWriter {
+  private:
+    static const int CHUNK_LEN = 32;
+
+    Print* out;
+    char chunk[CHUNK_LEN];
+    int chunkLength;
+    size_t written;
+    bool first;
+
+    void put(char c);
+    void put(const char* s);
+    void putString(const char* s);
+    void putKey(const char* key);
+    void putUnsigned(unsigned long value);
+
+  public:
+    explicit JsonObjectWriter(Print* out);
+
+    void begin();
+    void end(); // closes the object and flushes the last chunk
+    void add(const char* key, const char* value);
+    void add(const char* key, int value);
+    void add(const char* key, unsigned long value);
+    void add(const char* key, float value); // one decimal, enough for half degrees
+    void add(const char* key, bool value);
+
+    size_t length() const;
+};
+
+/*
+ * Publishes settings, status and timers to their topics, each only when one of its fields changed since
+ * the last publish. The payload length is counted in a first pass so it can be streamed into the client
+ * with beginPublish()/endPublish(), which also lifts PubSubClient's MQTT_MAX_PACKET_SIZE limit.
+ *
+ * Also takes commands on one topic per field (<prefix>/power, /mode, /temperature, /fan, /vane, /widevane,
+ * /remoteTemp) with plain payloads like "ON" or "22.5". Commands are only staged in the MQTT callback;
+ * applyCommands() in loop() sends everything staged since the last call with a single update().
+ *
+ * With setFahrenheit() temperatures are published in whole degrees Fahrenheit and commands are read as
+ * Fahrenheit, for integrations that do not convert themselves.
+ */
+class HeatPumpMqttBridge {
+  private:
+    PubSubClient& client;
+    const char* settingsTopic;
+    const char* statusTopic;
+    const char* timersTopic;
+    bool retainSettings;
+    bool fahrenheit;
+
+    heatpumpSettings lastSettings;
+    heatpumpStatus lastStatus;
+    bool settingsPublished;
+    bool statusPublished;
+
+    static const int COMMAND_VALUE_LEN = 12;
+    struct commandTopic {
+      const char* name;
+      byte length;
+    };
+    static const commandTopic COMMAND_TOPICS[];
+
+    const char* commandPrefix;
+    size_t commandPrefixLength;
+    char staged[7][COMMAND_VALUE_LEN]; // indexed by COMMAND_*
+    byte stagedCommands;               // bit per COMMAND_*
+
+    unsigned long published;
+    unsigned long skipped;
+    unsigned long failed;
+    uint32_t heapMin; // lowest free heap seen while publishing
+
+    void writeSettings(JsonObjectWriter& json, const heatpumpSettings& settings);
+    void writeStatus(JsonObjectWriter& json, const heatpumpStatus& status);
+    void writeTemperature(JsonObjectWriter& json, const char* key, float celsius);
+    float readTemperature(const char* value);
+    static void writeTimers(JsonObjectWriter& json, const heatpumpTimers& timers);
+
+    template<typename Writer>
+    bool publishJson(const char* topic, bool retain, Writer write);
+    void sampleHeap();
+
+  public:
+    static const byte COMMAND_POWER       = 0;
+    static const byte COMMAND_MODE        = 1;
+    static const byte COMMAND_TEMPERATURE = 2;
+    static const byte COMMAND_FAN         = 3;
+    static const byte COMMAND_VANE        = 4;
+    static const byte COMMAND_WIDEVANE    = 5;
+    static const byte COMMAND_REMOTE_TEMP = 6;
+    static const byte COMMAND_COUNT       = 7;
+
+    HeatPumpMqttBridge(PubSubClient& client, const char* settingsTopic, const char* statusTopic, const char* timersTopic);
+
+    // the settings topic is retained unless turned off here, status and timers always are
+    void setRetainSettings(bool retain);
+    void setFahrenheit(bool fahrenheit);
+
+    // force publishes even if nothing changed, e.g. as a periodic refresh
+    bool publishSettings(const heatpumpSettings& settings, bool force = false);
+    bool publishStatus(const heatpumpStatus& status, bool force = false);
+    // publish counters and, on ESP8266/ESP32, the free heap and its low-water mark to topic
+    bool publishStats(const char* topic);
+    // call after the client (re)connected, so the retained state is published again
+    void invalidate();
+
+    uint32_t getHeapMin(); // UINT32_MAX where the free heap is not known
+
+    // commands, subscribe to <commandPrefix>/+ to receive them
+    void setCommandPrefix(const char* commandPrefix);
+    // for the MQTT callback, returns false if topic is not a command topic
+    bool handleCommand(const char* topic, const byte* payload, unsigned int length);
+    // stages a value, a later value for the same command replaces it
+    void stage(byte command, const char* value, unsigned int length);
+    bool isStaged(byte command);
+    // from loop(), false if the update() failed or the remote temperature could not be queued
+    bool applyCommands(HeatPump& hp);
+};
+
+/*
+ * Collects packets for debug mode into one binary batch and publishes it base64 encoded, so the packet
+ * callback costs a copy instead of a String and a publish per packet. A batch is: version, frames dropped
+ * before it (2 bytes), millis() of its first frame (4 bytes), then per frame the ms since then (2 bytes),
+ * direction, length and the packet. Multi-byte fields are little-endian. While publishing would go over
+ * the bandwidth cap the batch is held back, and frames that no longer fit are dropped and counted.
+ */
+class HeatPumpPacketTrace {
+  private:
+    static const byte BATCH_VERSION = 1;
+    static const int BATCH_LEN = 240;       // 320 bytes in base64
+    static const int BATCH_HEADER_LEN = 7;
+    static const int FRAME_HEADER_LEN = 4;
+    static const int ENCODE_CHUNK_LEN = 32; // multiple of 4
+
+    PubSubClient& client;
+    const char* topic;
+    unsigned long bytesPerSecond;
+    unsigned long flushInterval;
+
+    byte batch[BATCH_LEN];
+    int batchLength;
+    unsigned long batchStart;
+    unsigned int dropped;
+
+    unsigned long budget; // bytes that may be published now, refilled at bytesPerSecond
+    unsigned long budgetUpdated;
+
+    unsigned long batches;
+    unsigned long droppedTotal;
+
+    static size_t encodedLength(int length);
+    void refillBudget();
+    bool publishBatch();
+
+  public:
+    static const byte DIRECTION_RECEIVED = 0;
+    static const byte DIRECTION_SENT     = 1;
+    static const byte DIRECTION_CUSTOM   = 2;
+
+    // bytesPerSecond 0 publishes without a cap
+    HeatPumpPacketTrace(PubSubClient& client, const char* topic, unsigned long bytesPerSecond = 256,
+                        unsigned long flushIntervalMs = 5000);
+
+    // for the packet callback, only copies the packet
+    void add(const byte* packet, unsigned int length, const char* packetDirection);
+    // from loop(), publishes a batch once it is mostly full or flushIntervalMs old and the cap allows it.
+    // false if publishing failed, the batch is then kept and published later
+    bool loop();
+
+    unsigned long getBatches();
+    unsigned long getDropped();
+};
+
+#endif // HEATPUMP_ENABLE_MQTT
+
+#endif
@@ -0,0 +1,419 @@
+/*
+  HeatPumpMqttGateway.cpp - Ready-made MQTT gateway for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "HeatPumpMqttGateway.h"
+#if HEATPUMP_ENABLE_MQTT
+
+// keys of the JSON set topic, the same commands as the per-field topics
+struct jsonCommand {
+  const char* key;
+  byte command;
+};
+static const jsonCommand JSON_COMMANDS[] = {
+  {"power", HeatPumpMqttBridge::COMMAND_POWER},
+  {"mode", HeatPumpMqttBridge::COMMAND_MODE},
+  {"temperature", HeatPumpMqttBridge::COMMAND_TEMPERATURE},
+  {"fan", HeatPumpMqttBridge::COMMAND_FAN},
+  {"vane", HeatPumpMqttBridge::COMMAND_VANE},
+  {"wideVane", HeatPumpMqttBridge::COMMAND_WIDEVANE},
+  {"remoteTemp", HeatPumpMqttBridge::COMMAND_REMOTE_TEMP}
+};
+
+static char* skipSpace(char* p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+    p++;
+  }
+  return p;
+}
+
+// Constructor /////////////////////////////////////////////////////////////////
+
+HeatPumpMqttGateway::HeatPumpMqttGateway(HeatPump& hp, PubSubClient& client, const heatpumpMqttLayout& layout,
+                                         unsigned long traceBytesPerSecond)
+  : hp(hp), client(client), layout(layout),
+    bridge(client, layout.settings, layout.status, layout.timers),
+    trace(client, layout.trace, traceBytesPerSecond),
+    clientId("heatpump"), username(nullptr), password(nullptr),
+    state(STATE_OFFLINE), retryStart(0), retryDelay(0), connects(0), failedConnects(0),
+    inbox(), inboxHead(0), inboxCount(0), inboxDropped(0),
+    debugMode(false), refreshInterval(60000), lastRefresh(0), refreshDue(false),
+    remoteTempActive(false), lastRemoteTemp(0) {
+  bridge.setRetainSettings(layout.retain);
+  bridge.setFahrenheit(layout.fahrenheit);
+  if (layout.fieldCommands) {
+    bridge.setCommandPrefix(layout.set);
+  }
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void HeatPumpMqttGateway::setCredentials(const char* clientId, const char* username, const char* password) {
+  this->clientId = clientId;
+  this->username = username;
+  this->password = password;
+}
+
+void HeatPumpMqttGateway::setRefreshInterval(unsigned long intervalMs) {
+  refreshInterval = intervalMs;
+}
+
+void HeatPumpMqttGateway::begin() {
+  hp.setSettingsChangedCallback([this]() {
+    if (state == STATE_CONNECTED && !bridge.publishSettings(hp.getSettings())) {
+      publishDebug("failed to publish to heatpump topic");
+    }
+  });
+  hp.setStatusChangedCallback([this](heatpumpStatus status) {
+    if (state == STATE_CONNECTED && !bridge.publishStatus(status)) {
+      publishDebug("failed to publish status or timer info");
+    }
+  });
+#if HEATPUMP_ENABLE_PACKET_CALLBACK
+  hp.setPacketCallback([this](byte* packet, unsigned int length, char* packetDirection) {
+    if (debugMode && layout.trace) {
+      trace.add(packet, length, packetDirection); // published in batches from loop()
+    }
+  });
+#endif
+  lastRefresh = millis();
+}
+
+void HeatPumpMqttGateway::loop(bool networkUp) {
+  updateConnection(networkUp);
+  processInbox();
+
+  // remote temperature first, so a timeout does not undo one that just arrived
+  if (bridge.isStaged(HeatPumpMqttBridge::COMMAND_REMOTE_TEMP)) {
+    remoteTempActive = true;
+    lastRemoteTemp = millis();
+  } else if (remoteTempActive && layout.remoteTempTimeoutMs > 0 &&
+             millis() - lastRemoteTemp >= layout.remoteTempTimeoutMs) {
+    // back to the unit's own sensor, tried again on the next loop if it could not be queued
+    remoteTempActive = !hp.setRemoteTemperature(0);
+  }
+
+  // settings staged by handleMessage() since the last loop, sent as one packet
+  if (!bridge.applyCommands(hp)) {
+    publishDebug("heatpump: update() or setRemoteTemperature() failed");
+  }
+
+  hp.sync();
+
+  if (state != STATE_CONNECTED) {
+    return;
+  }
+  if (refreshDue || millis() - lastRefresh >= refreshInterval) {
+    refresh();
+  }
+  if (layout.trace && !trace.loop()) {
+    publishDebug("failed to publish to trace topic");
+  }
+  client.loop();
+}
+
+bool HeatPumpMqttGateway::handleMessage(const char* topic, const byte* payload, unsigned int length) {
+  // <set>/<field>, plain values, staged right away
+  if (layout.fieldCommands && bridge.handleCommand(topic, payload, length)) {
+    return true;
+  }
+
+  byte inboxTopic;
+  if (layout.set && strcmp(topic, layout.set) == 0) {
+    inboxTopic = INBOX_SET;
+  } else if (layout.debugSet && strcmp(topic, layout.debugSet) == 0) {
+    inboxTopic = INBOX_DEBUG_SET;
+  } else {
+    return false;
+  }
+
+  // payload points into PubSubClient's buffer, which the next publish overwrites
+  if (inboxCount == INBOX_SLOTS || length >= INBOX_LEN) {
+    inboxDropped++;
+    return true;
+  }
+  inboxMessage& message = inbox[(inboxHead + inboxCount) % INBOX_SLOTS];
+  message.topic = inboxTopic;
+  message.length = length;
+  memcpy(message.payload, payload, length);
+  message.payload[length] = '\0';
+  inboxCount++;
+  return true;
+}
+
+bool HeatPumpMqttGateway::publishDebug(const char* message) {
+  if (state != STATE_CONNECTED || !layout.debug) {
+    return false;
+  }
+  return client.publish(layout.debug, message);
+}
+
+void HeatPumpMqttGateway::setDebug(bool debugMode) {
+  this->debugMode = debugMode;
+}
+
+bool HeatPumpMqttGateway::getDebug() {
+  return debugMode;
+}
+
+byte HeatPumpMqttGateway::getState() {
+  return state;
+}
+
+bool HeatPumpMqttGateway::isConnected() {
+  return state == STATE_CONNECTED;
+}
+
+unsigned long HeatPumpMqttGateway::getConnects() {
+  return connects;
+}
+
+unsigned long HeatPumpMqttGateway::getFailedConnects() {
+  return failedConnects;
+}
+
+unsigned long HeatPumpMqttGateway::getDroppedMessages() {
+  return inboxDropped;
+}
+
+HeatPumpMqttBridge& HeatPumpMqttGateway::getBridge() {
+  return bridge;
+}
+
+HeatPumpPacketTrace& HeatPumpMqttGateway::getTrace() {
+  return trace;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+void HeatPumpMqttGateway::updateConnection(bool networkUp) {
+  if (state == STATE_CONNECTED) {
+    if (networkUp && client.connected()) {
+      return;
+    }
+    // try again right away, the broker may only have dropped this one connection
+    state = STATE_RETRYING;
+    retryDelay = 0;
+  }
+
+  if (!networkUp) {
+    state = STATE_OFFLINE;
+    return;
+  }
+  if (state == STATE_OFFLINE) {
+    state = STATE_RETRYING;
+    retryDelay = 0;
+  }
+  if (retryDelay > 0 && millis() - retryStart < retryDelay) {
+    return;
+  }
+
+  // a single attempt per loop(), it blocks at most for the client's connect timeout
+  if (client.connect(clientId, username, password)) {
+    onConnected();
+    return;
+  }
+  failedConnects++;
+  retryStart = millis();
+  retryDelay = retryDelay == 0 ? RETRY_MIN_MS : retryDelay * 2;
+  if (retryDelay > RETRY_MAX_MS) {
+    retryDelay = RETRY_MAX_MS;
+  }
+}
+
+void HeatPumpMqttGateway::onConnected() {
+  state = STATE_CONNECTED;
+  retryDelay = 0;
+  connects++;
+
+  if (layout.set) {
+    client.subscribe(layout.set);
+    if (layout.fieldCommands) {
+      // "<set>/+", built on the stack so the layout only needs the one set topic
+      char fields[64];
+      size_t length = strlen(layout.set);
+      if (length + 3 <= sizeof(fields)) {
+        memcpy(fields, layout.set, length);
+        memcpy(fields + length, "/+", 3);
+        client.subscribe(fields);
+      }
+    }
+  }
+  if (layout.debugSet) {
+    client.subscribe(layout.debugSet);
+  }
+
+  bridge.invalidate();
+  refreshDue = true; // publish the full state on this loop
+}
+
+void HeatPumpMqttGateway::processInbox() {
+  while (inboxCount > 0) {
+    inboxMessage& message = inbox[inboxHead];
+    inboxHead = (inboxHead + 1) % INBOX_SLOTS;
+    inboxCount--;
+
+    if (message.topic == INBOX_SET) {
+      if (!stageJson(message.payload)) {
+        publishDebug("invalid JSON on the set topic");
+      }
+    } else if (strcmp(message.payload, "on") == 0) {
+      debugMode = true;
+      publishDebug("debug mode enabled");
+    } else if (strcmp(message.payload, "off") == 0) {
+      debugMode = false;
+      publishDebug("debug mode disabled");
+    }
+  }
+}
+
+// Walks a flat JSON object in place and stages the fields it knows. Strings are unescaped where they
+// are, other values (numbers) are kept as text for the bridge. Nested objects and arrays are rejected.
+bool HeatPumpMqttGateway::stageJson(char* json) {
+  char* p = skipSpace(json);
+  if (*p++ != '{') {
+    return false;
+  }
+  const char* custom = nullptr;
+
+  p = skipSpace(p);
+  if (*p == '}') {
+    return true;
+  }
+  for (;;) {
+    // key, without escapes
+    if (*p++ != '"') {
+      return false;
+    }
+    const char* key = p;
+    while (*p && *p != '"') {
+      p++;
+    }
+    if (!*p) {
+      return false;
+    }
+    *p++ = '\0';
+    p = skipSpace(p);
+    if (*p++ != ':') {
+      return false;
+    }
+    p = skipSpace(p);
+
+    // value
+    char* value = p;
+    char* valueEnd;
+    if (*p == '"') {
+      value = ++p;
+      valueEnd = p;
+      while (*p && *p != '"') {
+        if (*p == '\\' && p[1]) {
+          p++;
+        }
+        *valueEnd++ = *p++;
+      }
+      if (!*p) {
+        return false;
+      }
+      p++;
+    } else {
+      while (*p && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+        if (*p == '{' || *p == '[') {
+          return false;
+        }
+        p++;
+      }
+      valueEnd = p;
+    }
+    char separator = *(p = skipSpace(p));
+    if (separator != ',' && separator != '}') {
+      return false;
+    }
+    p++;
+    *valueEnd = '\0'; // after reading the separator, it may be the same byte
+
+    if (strcmp(value, "null") != 0) {
+      for (unsigned int i = 0; i < sizeof(JSON_COMMANDS) / sizeof(JSON_COMMANDS[0]); i++) {
+        if (strcmp(key, JSON_COMMANDS[i].key) == 0) {
+          bridge.stage(JSON_COMMANDS[i].command, value, valueEnd - value);
+          break;
+        }
+      }
+      if (strcmp(key, "custom") == 0) {
+        custom = value;
+      }
+    }
+
+    if (separator == '}') {
+      break;
+    }
+    p = skipSpace(p);
+  }
+
+  // a custom packet is only sent with no remote temperature in the same message, as always
+  if (custom && !bridge.isStaged(HeatPumpMqttBridge::COMMAND_REMOTE_TEMP)) {
+    sendCustomPacket(custom);
+  }
+  return true;
+}
+
+// "fc 41 01 30 ...", hex bytes separated by spaces
+void HeatPumpMqttGateway::sendCustomPacket(const char* hex) {
+#if HEATPUMP_ENABLE_CUSTOM_PACKETS
+  byte bytes[20]; // max custom packet bytes is 20
+  int byteCount = 0;
+  char* next;
+  while (byteCount < 20) {
+    long value = strtol(hex, &next, 16);
+    if (next == hex) {
+      break;
+    }
+    bytes[byteCount++] = value;
+    hex = next;
+  }
+  if (byteCount == 0) {
+    return;
+  }
+
+  // trace it, handy to test custom packets without a heat pump connected
+  if (debugMode && layout.trace) {
+    trace.add(bytes, byteCount, "customPacket");
+  }
+  if (!hp.sendCustomPacket(bytes, byteCount)) {
+    publishDebug("heatpump: custom packet not queued");
+  }
+#else
+  (void)hex;
+#endif
+}
+
+void HeatPumpMqttGateway::refresh() {
+  refreshDue = false;
+  lastRefresh = millis();
+  if (layout.stats) {
+    bridge.publishStats(layout.stats);
+  }
+  heatpumpSettings settings = hp.getSettings();
+  if (!settings.power) {
+    return; // nothing decoded yet, the callbacks publish once the unit answers
+  }
+  // the full state, like before the bridge skipped unchanged payloads; the callbacks only send changes
+  if (!bridge.publishSettings(settings, true)) {
+    publishDebug("failed to publish to heatpump topic");
+  }
+  if (!bridge.publishStatus(hp.getStatus(), true)) {
+    publishDebug("failed to publish status or timer info");
+  }
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+  HeatPumpMqttGateway.h - Ready-made MQTT gateway for the HeatPump library
+  Copyright (c) 2017 Al Betschart.  All right reserved.
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __HeatPumpMqttGateway_H__
+#define __HeatPumpMqttGateway_H__
+#include "HeatPumpConfig.h"
+#if HEATPUMP_ENABLE_MQTT
+#include "HeatPumpMqttBridge.h"
+
+/*
+ * Where a gateway publishes and what it listens to. Each integration keeps its own layout, e.g. the MQTT
+ * example uses "heatpump/..." with per-field commands, the OpenHAB template "home/heatpump/..." in
+ * Fahrenheit. Topics that are nullptr are not used.
+ */
+struct heatpumpMqttLayout {
+  const char* settings;  // current settings as JSON
+  const char* set;       // JSON commands, and with fieldCommands the prefix of <set>/power, <set>/mode, ...
+  const char* status;    // room temperature and operating as JSON
+  const char* timers;    // timers as JSON
+  const char* debug;     // text messages, e.g. failed publishes
+  const char* debugSet;  // "on" or "off" turns debug mode on or off
+  const char* trace;     // packet batches while debug mode is on, see HeatPumpPacketTrace
+  const char* stats;     // bridge counters and free heap, on every refresh
+  bool fieldCommands;    // also subscribe to <set>/+
+  bool retain;           // retain the settings topic, status and timers are always retained
+  bool fahrenheit;       // temperatures in and out in whole degrees Fahrenheit
+  unsigned long remoteTempTimeoutMs; // back to the unit's own sensor when remoteTemp stops coming, 0 for never
+};
+
+/*
+ * Everything between a HeatPump and an MQTT broker, so a sketch only sets up WiFi and calls loop():
+ * settings and status are published when they change (through HeatPumpMqttBridge), JSON and per-field
+ * commands are applied with one update() per loop, and debug mode traces packets in batches.
+ *
+ * Nothing in loop() blocks for long. A lost broker is retried with a growing delay, one attempt per
+ * loop(), while sync() keeps running. Messages for the set and debug topics are copied into a small
+ * fixed pool in the MQTT callback and handled in the next loop(), outside PubSubClient's buffer, so
+ * replies can be published safely and nothing is allocated.
+ */
+class HeatPumpMqttGateway {
+  private:
+    static const int INBOX_SLOTS = 3;
+    static const int INBOX_LEN = 128; // the longest JSON command with all fields, or 20 custom packet bytes
+    static const unsigned long RETRY_MIN_MS = 1000;
+    static const unsigned long RETRY_MAX_MS = 60000;
+
+    static const byte INBOX_SET       = 0;
+    static const byte INBOX_DEBUG_SET = 1;
+
+    struct inboxMessage {
+      byte topic; // INBOX_*
+      byte length;
+      char payload[INBOX_LEN];
+    };
+
+    HeatPump& hp;
+    PubSubClient& client;
+    const heatpumpMqttLayout& layout;
+    HeatPumpMqttBridge bridge;
+    HeatPumpPacketTrace trace;
+
+    const char* clientId;
+    const char* username;
+    const char* password;
+
+    byte state;
+    unsigned long retryStart;
+    unsigned long retryDelay;
+    unsigned long connects;
+    unsigned long failedConnects;
+
+    inboxMessage inbox[INBOX_SLOTS];
+    byte inboxHead;
+    byte inboxCount;
+    unsigned long inboxDropped;
+
+    bool debugMode;
+    unsigned long refreshInterval;
+    unsigned long lastRefresh;
+    bool refreshDue;
+    bool remoteTempActive;
+    unsigned long lastRemoteTemp;
+
+    void updateConnection(bool networkUp);
+    void onConnected();
+    void processInbox();
+    bool stageJson(char* json);
+    void sendCustomPacket(const char* hex);
+    void refresh();
+
+  public:
+    static const byte STATE_OFFLINE   = 0; // no network, not trying
+    static const byte STATE_RETRYING  = 1; // waiting for the next connect attempt
+    static const byte STATE_CONNECTED = 2;
+
+    // layout must outlive the gateway, keep it in a global or static
+    HeatPumpMqttGateway(HeatPump& hp, PubSubClient& client, const heatpumpMqttLayout& layout,
+                        unsigned long traceBytesPerSecond = 256);
+
+    // username and password may be nullptr
+    void setCredentials(const char* clientId, const char* username, const char* password);
+    // how often settings, status and stats are checked for changes besides the callbacks, default 60 s
+    void setRefreshInterval(unsigned long intervalMs);
+
+    // registers the settings, status and packet callbacks of hp, call before hp.connect()
+    void begin();
+    // from loop(), instead of hp.sync() and client.loop(). networkUp false skips the broker, e.g.
+    // WiFi.status() == WL_CONNECTED
+    void loop(bool networkUp = true);
+    // for the MQTT callback, returns false if the topic is not one of the gateway's
+    bool handleMessage(const char* topic, const byte* payload, unsigned int length);
+
+    bool publishDebug(const char* message);
+    void setDebug(bool debugMode);
+    bool getDebug();
+
+    byte getState();
+    bool isConnected();
+    unsigned long getConnects();       // successful connects to the broker
+    unsigned long getFailedConnects();
+    unsigned long getDroppedMessages(); // set and debug messages that did not fit the pool
+    HeatPumpMqttBridge& getBridge();
+    HeatPumpPacketTrace& getTrace();
+};
+
+#endif // HEATPUMP_ENABLE_MQTT
+
+#endif